@@ -0,0 +1,216 @@
+#include "BarnesHut.h"
+#include <math.h>
+#include <algorithm>
+using namespace LinearAlgebra;
+using std::min;
+using std::max;
+
+template<typename Real>
+BarnesHut<Real>::BarnesHut(double strength, double openingAngle, double softening)
+{
+	_strength = strength;
+	_openingAngle = openingAngle;
+	_softening = softening;
+}
+
+template<typename Real>
+double BarnesHut<Real>::strength() const
+{
+	return _strength;
+}
+
+template<typename Real>
+double BarnesHut<Real>::openingAngle() const
+{
+	return _openingAngle;
+}
+
+template<typename Real>
+double BarnesHut<Real>::softening() const
+{
+	return _softening;
+}
+
+template<typename Real>
+int BarnesHut<Real>::nodes() const
+{
+	return _nodes.size();
+}
+
+template<typename Real>
+void BarnesHut<Real>::setStrength(double strength)
+{
+	_strength = strength;
+}
+
+template<typename Real>
+void BarnesHut<Real>::setOpeningAngle(double angle)
+{	// About 0.5 keeps the force within a percent or so, larger is faster and rougher
+	_openingAngle = max(0.0, angle);
+}
+
+template<typename Real>
+void BarnesHut<Real>::setSoftening(double length)
+{
+	_softening = max(0.0, length);
+}
+
+template<typename Real>
+void BarnesHut<Real>::applyForces(std::vector<Polygon<Real>>& polygons, Real dt, ThreadPool& threads)
+{	// The walks only read the tree, so fixed chunks of bodies run on any thread and each writes its own bodies.
+	// Chunks go by tree order, so a task's bodies are close together and walk mostly the same nodes.
+	if (_strength == 0 || polygons.size() < 2)
+		return;
+
+	build(polygons);
+	int n = polygons.size();
+	threads.run((n + ForceChunk - 1) / ForceChunk, [&](int task) {
+		int last = min(n, (task + 1) * ForceChunk);
+		for (int slot = task * ForceChunk; slot < last; slot++) {
+			auto a = acceleration(slot);
+			auto& p = polygons[_order[slot]];
+			p.setVelocity(Real(p.xVelocity() + a.x * dt), Real(p.yVelocity() + a.y * dt), p.angleVelocity());
+		}
+	});
+}
+
+template<typename Real>
+void BarnesHut<Real>::build(const std::vector<Polygon<Real>>& polygons)
+{	// Square around all bodies, split top down, then the bodies copied into tree order
+	int n = polygons.size();
+	_x.resize(n);
+	_y.resize(n);
+	_mass.resize(n);
+	_order.resize(n);
+	Point<double> low = { polygons[0].xPos(), polygons[0].yPos() };
+	Point<double> high = low;
+	for (int i = 0; i < n; i++) {
+		_x[i] = polygons[i].xPos();
+		_y[i] = polygons[i].yPos();
+		_mass[i] = polygons[i].mass();
+		_order[i] = i;
+		low = { min(low.x, _x[i]), min(low.y, _y[i]) };
+		high = { max(high.x, _x[i]), max(high.y, _y[i]) };
+	}
+
+	_nodes.clear();
+	buildNode(0, n, low.x, low.y, max(max(high.x - low.x, high.y - low.y), 1e-9), 0);
+
+	_scratch.resize(n);
+	for (auto* values : { &_x, &_y, &_mass }) {
+		for (int slot = 0; slot < n; slot++)
+			_scratch[slot] = (*values)[_order[slot]];
+		values->swap(_scratch);
+	}
+}
+
+template<typename Real>
+void BarnesHut<Real>::buildNode(int first, int last, double minX, double minY, double size, int depth)
+{	// Up to LeafSize bodies make a leaf, more are split in four around the middle of the square.
+	// Bodies are still read by body index here, the slots only get their copies once the tree is done.
+	int index = _nodes.size();
+	_nodes.push_back({ 0, 0, 0, size, first, last, 0, true });
+
+	if (last - first > LeafSize && depth < MaxDepth)
+	{
+		double half = 0.5 * size;
+		double midX = minX + half;
+		double midY = minY + half;
+		int* order = _order.data();
+		auto left = [&](int body) { return _x[body] < midX; };
+		auto below = [&](int body) { return _y[body] < midY; };
+		int splitX = std::partition(order + first, order + last, left) - order;
+		int splitLeft = std::partition(order + first, order + splitX, below) - order;
+		int splitRight = std::partition(order + splitX, order + last, below) - order;
+
+		int bounds[5] = { first, splitLeft, splitX, splitRight, last };
+		Point<double> corners[4] = { { minX, minY }, { minX, midY }, { midX, minY }, { midX, midY } };
+		int children[4];
+		int childCount = 0;
+		for (int q = 0; q < 4; q++) {
+			if (bounds[q] == bounds[q + 1])
+				continue;
+			children[childCount++] = _nodes.size();
+			buildNode(bounds[q], bounds[q + 1], corners[q].x, corners[q].y, half, depth + 1);
+		}
+
+		double mass = 0, x = 0, y = 0;
+		for (int c = 0; c < childCount; c++) {
+			auto& child = _nodes[children[c]];
+			mass += child.mass;
+			x += child.mass * child.x;
+			y += child.mass * child.y;
+		}
+		auto& node = _nodes[index];
+		node.leaf = false;
+		node.mass = mass;
+		node.x = x / mass;
+		node.y = y / mass;
+	}
+	else
+	{
+		double mass = 0, x = 0, y = 0;
+		for (int i = first; i < last; i++) {
+			int body = _order[i];
+			mass += _mass[body];
+			x += _mass[body] * _x[body];
+			y += _mass[body] * _y[body];
+		}
+		auto& node = _nodes[index];
+		node.mass = mass;
+		node.x = x / mass;
+		node.y = y / mass;
+	}
+	_nodes[index].next = _nodes.size();
+}
+
+template<typename Real>
+Point<double> BarnesHut<Real>::acceleration(int slot) const
+{	// Walk the nodes in order: a node far enough away counts as one mass and the walk skips its subtree,
+	// a near leaf is summed body by body and a near inner node is opened by stepping to its first child.
+	// A node holding the body itself is always opened, past an opening angle of about 0.7 its center of mass
+	// can be far enough off for the node to pass as distant, and the body would pull on itself.
+	double x = _x[slot];
+	double y = _y[slot];
+	double angleSquared = _openingAngle * _openingAngle;
+	double softeningSquared = _softening * _softening;
+	Point<double> a = { 0, 0 };
+	auto pull = [&](double mass, double dx, double dy, double distanceSquared) {
+		double inverse = 1 / sqrt(distanceSquared + softeningSquared);
+		double scale = _strength * mass * inverse * inverse * inverse;
+		a.x += scale * dx;
+		a.y += scale * dy;
+	};
+
+	int count = _nodes.size();
+	int i = 0;
+	while (i < count) {
+		auto& node = _nodes[i];
+		double dx = node.x - x;
+		double dy = node.y - y;
+		double distanceSquared = dx * dx + dy * dy;
+		bool holdsBody = slot >= node.first && slot < node.last;
+		if (!holdsBody && node.size * node.size < angleSquared * distanceSquared)
+		{
+			pull(node.mass, dx, dy, distanceSquared);
+			i = node.next;
+		}
+		else if (node.leaf)
+		{
+			for (int j = node.first; j < node.last; j++) {
+				if (j == slot)
+					continue;
+				double bx = _x[j] - x;
+				double by = _y[j] - y;
+				pull(_mass[j], bx, by, bx * bx + by * by);
+			}
+			i = node.next;
+		}
+		else
+			i++;
+	}
+	return a;
+}
+
+template class BarnesHut<float>;
+template class BarnesHut<double>;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include "Polygon.h"
+#include "LinearAlgebra.h"
+#include "ThreadPool.h"
+
+// Long range force between every pair of bodies, falling off with the square of the distance and with the body
+// masses as charges. A quadtree of the masses is built each step and far groups of bodies act as one mass at their
+// center, so a step costs O(N log N) instead of a sum over all pairs. Periodic copies of bodies are not seen.
+template<typename Real>
+class BarnesHut
+{
+public:
+	//Constructor
+	BarnesHut(double strength = 0, double openingAngle = 0.5, double softening = 1);
+	//Accessors
+	double strength() const;
+	double openingAngle() const;
+	double softening() const;
+	int nodes() const;
+	//Functions
+	void setStrength(double strength);			// Positive attracts like gravity, negative repels like equal charges, 0 is off
+	void setOpeningAngle(double angle);			// Node size over distance below which a node counts as one mass, 0 sums every pair
+	void setSoftening(double length);			// Added to distances so close bodies never see a force blowing up
+	void applyForces(std::vector<Polygon<Real>>& polygons, Real dt, ThreadPool& threads);	// Velocities only, before integration
+private:
+	struct Node {						// Depth first, children follow their parent
+		double x;						// Center of mass
+		double y;
+		double mass;
+		double size;					// Side of the node's square
+		int first;						// Bodies below the node, as slots in tree order
+		int last;
+		int next;						// First node after the subtree, where the walk goes when the node is not opened
+		bool leaf;
+	};
+	static const int LeafSize = 8;
+	static const int MaxDepth = 40;		// Bodies on the same spot end up in one leaf instead of splitting forever
+	static const int ForceChunk = 256;	// Bodies per task, fixed so the split never depends on the thread count
+
+	//Variables
+	double _strength;
+	double _openingAngle;
+	double _softening;
+	std::vector<Node> _nodes;
+	std::vector<int> _order;			// Body in each slot
+	std::vector<double> _x;				// Per slot, so the bodies of a leaf are next to each other
+	std::vector<double> _y;
+	std::vector<double> _mass;
+	std::vector<double> _scratch;		// Swapped with each of the above while copying into tree order
+	//Private functions
+	void build(const std::vector<Polygon<Real>>& polygons);
+	void buildNode(int first, int last, double minX, double minY, double size, int depth);
+	LinearAlgebra::Point<double> acceleration(int slot) const;
+};
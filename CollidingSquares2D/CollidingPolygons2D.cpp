@@ -2,9 +2,18 @@
 #include <iostream>
 #include "Engine.h"
 #include "Dice.h"
+#include "ContactBenchmark.h"
 
 int main()
 {
+#ifdef CONTACT_BENCHMARK
+    // Contact velocity pass timings instead of the window
+    ContactBenchmark<double>::run(20000, 30000, 200, std::cout);
+    ContactBenchmark<float>::run(20000, 30000, 200, std::cout);
+    ContactBenchmark<double>::run(100000, 150000, 50, std::cout);
+    ContactBenchmark<double>::run(20000, 30000, 200, std::cout, 200);
+    ContactBenchmark<float>::run(20000, 30000, 200, std::cout, 200);
+#else
     Engine engine(1000, 800, 3, 3);
     while (engine.isRunning())
     {
@@ -15,4 +24,5 @@ int main()
 
     std::cout << "Hello World!" << "\n";
     std::cout << Roll::d(6) << "\n";
+#endif
 }
\ No newline at end of file
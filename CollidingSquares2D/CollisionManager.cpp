@@ -1,61 +1,102 @@
 #include "CollisionManager.h"
 #include <math.h>
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+#include "SimdKernels.h"
 using namespace LinearAlgebra;
 using std::min;
 using std::max;
 
-CollisionManager::CollisionManager(int width2D, int height2D,
+static unsigned int mortonCode(unsigned int x, unsigned int y)
+{	// Interleave the low 16 bits of x and y, x in the even bits
+	auto spread = [](unsigned int v) {
+		v &= 0xFFFF;
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+template<typename Real>
+static const Point<Real>* narrowCorners(const std::vector<Point<Real>>& corners, const Polygon<Real>&, Point<Real>*)
+{	// Same precision, the kernel reads the corners where they are
+	return corners.data();
+}
+
+template<typename Narrow, typename Real>
+static const Point<Narrow>* narrowCorners(const std::vector<Point<Real>>& corners, const Polygon<Real>& origin, Point<Narrow>* scratch)
+{	// Lower precision, corners relative to one body's center keep their precision far from the world origin
+	for (int i = 0; i < corners.size(); i++)
+		scratch[i] = { Narrow(corners[i].x - origin.xPos()), Narrow(corners[i].y - origin.yPos()) };
+	return scratch;
+}
+
+template<typename Real, typename Narrow>
+CollisionManager<Real, Narrow>::CollisionManager(int width2D, int height2D,
 	int collisionGridColumns, int collisionGridRows)
 {
 	_width = width2D;
 	_height = height2D;
-	_columns = collisionGridColumns;
-	_rows = collisionGridRows;
-	_collisionGrid.resize(_rows * _columns);
+	_adaptiveGrid = collisionGridColumns <= 0 || collisionGridRows <= 0;
+	if (_adaptiveGrid)
+		resizeCollisionGrid(3, 3);
+	else
+		resizeCollisionGrid(collisionGridColumns, collisionGridRows);
+	_gridHierarchy.resize(_width, _height);
+	_threadPool.reset(new ThreadPool());
 }
 
-void CollisionManager::wallCollisionHandling(Polygon& p) const
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::wallCollisionHandling(Polygon<Real>& p) const
 {	// Discrete collision
-	double C_R = 1.0;
+	if (!_walls)
+		return;
 
-	Point vel = { p.xVelocity(), p.yVelocity() };
-	double angleVel = p.angleVelocity();
+	Real C_R = 1;
 
-	auto vertexClosestToX = [&](double X) -> const Point& {
+	Point<Real> vel = { p.xVelocity(), p.yVelocity() };
+	Real angleVel = p.angleVelocity();
+
+	const auto& vertices = p.vertices();
+	auto vertexClosestToX = [&](Real X) -> const Point<Real>& {
 		int closest = 0;
-		double distanceToX = std::numeric_limits<double>::max();
-		for (int i = 0; i < p.vertices().size(); i++)
+		Real distanceToX = std::numeric_limits<Real>::max();
+		for (int i = 0; i < vertices.size(); i++)
 		{
-			double dx = abs(p.vertices()[i].x - X);
+			Real dx = abs(vertices[i].x - X);
 			if (dx < distanceToX)
 			{
 				closest = i;
 				distanceToX = dx;
 			}
 		}
-		return p.vertices()[closest];
+		return vertices[closest];
 	};
-	auto vertexClosestToY = [&](double Y) -> const Point& {
+	auto vertexClosestToY = [&](Real Y) -> const Point<Real>& {
 		int closest = 0;
-		double distanceToY = std::numeric_limits<double>::max();
-		for (int i = 0; i < p.vertices().size(); i++)
+		Real distanceToY = std::numeric_limits<Real>::max();
+		for (int i = 0; i < vertices.size(); i++)
 		{
-			double dy = abs(p.vertices()[i].y - Y);
+			Real dy = abs(vertices[i].y - Y);
 			if (dy < distanceToY)
 			{
 				closest = i;
 				distanceToY = dy;
 			}
 		}
-		return p.vertices()[closest];
+		return vertices[closest];
 	};
-	auto calculateNewVelocities = [&](const Point& collision, const Point& normal)
+	auto calculateNewVelocities = [&](const Point<Real>& collision, const Point<Real>& normal)
 	{
-		Point R = { collision.x - p.xPos(), collision.y - p.yPos() };
-		double RxN = cross(R, normal);
-		Point velTotal = { vel.x - angleVel * R.y, vel.y + angleVel * R.x };
-		double impulse = -(1.0 + C_R) * dot(velTotal, normal) / 
-						((1.0/p.mass()) + p.invInertia()*RxN*RxN);
+		Point<Real> R = { collision.x - p.xPos(), collision.y - p.yPos() };
+		Real RxN = cross(R, normal);
+		Point<Real> velTotal = { vel.x - angleVel * R.y, vel.y + angleVel * R.x };
+		Real impulse = -(1 + C_R) * dot(velTotal, normal) / 
+						((1/p.mass()) + p.invInertia()*RxN*RxN);
 
 		angleVel += p.invInertia() * RxN * impulse;
 		vel.x += (impulse / p.mass()) * normal.x;
@@ -63,7 +104,7 @@ void CollisionManager::wallCollisionHandling(Polygon& p) const
 	};
 
 	const int Big = 10 * _width * _height;
-	if (p.xPos() - p.vertexRadius() < 0)
+	if (!_periodicX && p.xPos() - p.vertexRadius() < 0)
 	{
 		auto& deepestInWall = vertexClosestToX(-Big);
 		if (deepestInWall.x < 0) 
@@ -72,7 +113,7 @@ void CollisionManager::wallCollisionHandling(Polygon& p) const
 			calculateNewVelocities(deepestInWall, { 1, 0 });
 		}
 	}
-	if (p.xPos() + p.vertexRadius() > _width) 
+	if (!_periodicX && p.xPos() + p.vertexRadius() > _width) 
 	{
 		auto& deepestInWall = vertexClosestToX(Big);
 		if (deepestInWall.x > _width)
@@ -81,7 +122,7 @@ void CollisionManager::wallCollisionHandling(Polygon& p) const
 			calculateNewVelocities(deepestInWall, { -1, 0 });
 		}
 	}
-	if (p.yPos() - p.vertexRadius() < 0) 
+	if (!_periodicY && p.yPos() - p.vertexRadius() < 0) 
 	{
 		auto& deepestInWall = vertexClosestToY(-Big);
 		if (deepestInWall.y < 0)
@@ -90,7 +131,7 @@ void CollisionManager::wallCollisionHandling(Polygon& p) const
 			calculateNewVelocities(deepestInWall, { 0, 1 });
 		}
 	}
-	if (p.yPos() + p.vertexRadius() > _height) 
+	if (!_periodicY && p.yPos() + p.vertexRadius() > _height) 
 	{
 		auto& deepestInWall = vertexClosestToY(Big);
 		if (deepestInWall.y > _height)
@@ -103,90 +144,411 @@ void CollisionManager::wallCollisionHandling(Polygon& p) const
 	p.setVelocity(vel.x, vel.y, angleVel);
 }
 
-void CollisionManager::collisionCheckAndResolution(Polygon& a, Polygon& b) const
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::staticCollisionHandling(Polygon<Real>& p) const
+{	// Only the static shapes whose grid cells the body's box touches, nothing at all far from them
+	if (_staticGeometry.empty())
+		return;
+
+	Point<double> low = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+	Point<double> high = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+	for (auto& vertex : p.vertices()) {
+		low = { min(low.x, double(vertex.x)), min(low.y, double(vertex.y)) };
+		high = { max(high.x, double(vertex.x)), max(high.y, double(vertex.y)) };
+	}
+	_staticGeometry.forEachNear(low, high, [&](int shape) {
+		staticCollision(p, shape);
+	});
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::staticCollision(Polygon<Real>& p, int shape) const
+{	// SAT against one static shape, then the body alone is pushed out and bounces like off a wall
+	int corners = _staticGeometry.shapeSize(shape);
+	const Point<Real>* shapeCorners = _staticGeometry.shapeCorners(shape);
+	const Point<Real>* shapeNormals = _staticGeometry.shapeNormals(shape);
+
+	Real minOverlap = std::numeric_limits<Real>::max();
+	Point<Real> collisionNormal;		// From the static shape towards the body
+	bool staticAxis = true;
+	auto overlapsOn = [&](const Point<Real>& n, bool fromShape) {
+		auto bodyProj = project(p.vertices(), n);
+		Projection<Real> shapeProj;
+		for (int i = 0; i < corners; i++) {
+			Real length = dot(shapeCorners[i], n);
+			shapeProj.max = max(shapeProj.max, length);
+			shapeProj.min = min(shapeProj.min, length);
+		}
+		if (!overlap(bodyProj, shapeProj))
+			return false;
+
+		Real depth = min(bodyProj.max, shapeProj.max) - max(bodyProj.min, shapeProj.min);
+		if (depth < minOverlap)
+		{
+			Real side = bodyProj.min + bodyProj.max < shapeProj.min + shapeProj.max ? -1 : 1;
+			minOverlap = depth;
+			collisionNormal = { side * n.x, side * n.y };
+			staticAxis = fromShape;
+		}
+		return true;
+	};
+
+	for (int i = 0; i < corners; i++) {
+		if (!overlapsOn(shapeNormals[i], true))
+			return;
+	}
+	Point<Real> prev = p.vertices().back();
+	for (auto& vertex : p.vertices()) {
+		if (!overlapsOn(normal(vertex, prev, _fastMath), false))
+			return;
+		prev = vertex;
+	}
+
+	// Contact at the deepest corner of whichever shape did not give the axis
+	Point<Real> collision;
+	if (staticAxis)
+	{
+		Real deepest = std::numeric_limits<Real>::max();
+		for (auto& vertex : p.vertices()) {
+			if (dot(vertex, collisionNormal) < deepest)
+			{
+				deepest = dot(vertex, collisionNormal);
+				collision = vertex;
+			}
+		}
+	}
+	else
+	{
+		Real deepest = std::numeric_limits<Real>::lowest();
+		for (int i = 0; i < corners; i++) {
+			if (dot(shapeCorners[i], collisionNormal) > deepest)
+			{
+				deepest = dot(shapeCorners[i], collisionNormal);
+				collision = shapeCorners[i];
+			}
+		}
+	}
+
+	p.setPosition(p.xPos() + collisionNormal.x * minOverlap, p.yPos() + collisionNormal.y * minOverlap);
+
+	Real C_R = 1;
+	Point<Real> R = { collision.x - p.xPos(), collision.y - p.yPos() };
+	Real RxN = cross(R, collisionNormal);
+	Point<Real> velTotal = { p.xVelocity() - p.angleVelocity() * R.y, p.yVelocity() + p.angleVelocity() * R.x };
+	Real approach = dot(velTotal, collisionNormal);
+	if (approach >= 0)
+		return;
+
+	Real impulse = -(1 + C_R) * approach / ((1 / p.mass()) + p.invInertia() * RxN * RxN);
+	p.setVelocity(p.xVelocity() + (impulse / p.mass()) * collisionNormal.x,
+		p.yVelocity() + (impulse / p.mass()) * collisionNormal.y,
+		p.angleVelocity() + p.invInertia() * RxN * impulse);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::collisionCheckAndResolution(Polygon<Real>& a, Polygon<Real>& b) const
 {
+	Real depth;
 	if (!rad_collided(a, b))
 		return;
-	if (!sat_collided(a, b, WithOverlapRemoval))
-		return;
-	if (a.hasCollidedWith(b))
+	if (!sat_collided(a, b, &depth))
 		return;
-	
+	auto found = contact(a, b, 0, 0, depth);
+	collisionResolution(a, b, found);
+	correctPosition(a, b, found);
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::Contact CollisionManager<Real, Narrow>::contact(Polygon<Real>& a, Polygon<Real>& b, int aIndex, int bIndex, Real depth) const
+{	// Contact point and normal of two bodies already known to overlap, nothing is moved
 	auto collision = collisionData(a, b);
-	double C_R = 1;		//Coefficient of restitution (1 -> no energy loss)
-	if (collision.NormalOnFirstArg) 
-	{
-		collision.Normal.x *= -1;
-		collision.Normal.y *= -1;
-	}
+	Point<Real> n = collision.Normal;
+	if (dot(n, { a.xPos() - b.xPos(), a.yPos() - b.yPos() }) < 0)
+		n = { -n.x, -n.y };
+	return { aIndex, bIndex, collision.Point, n, depth };
+}
 
-	Point a_R = { collision.Point.x - a.xPos(), collision.Point.y - a.yPos() };
-	double a_RxN = cross(a_R, collision.Normal);
-	Point a_velTotal = { a.xVelocity() - a.angleVelocity() * a_R.y, a.yVelocity() + a.angleVelocity() * a_R.x};
-	Point b_R = { collision.Point.x - b.xPos(), collision.Point.y - b.yPos() };
-	double b_RxN = cross(b_R, collision.Normal);
-	Point b_VelTotal = { b.xVelocity() - b.angleVelocity() * b_R.y, b.yVelocity() + b.angleVelocity() * b_R.x };
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::collisionResolution(Polygon<Real>& a, Polygon<Real>& b, const Contact& contact) const
+{	// Impulse response, velocities only, pairs already moving apart are left alone
+	Real C_R = 1;		//Coefficient of restitution (1 -> no energy loss)
 
-	double impulse = -(1.0 + C_R) * dot({ a_velTotal.x - b_VelTotal.x, a_velTotal.y - b_VelTotal.y }, collision.Normal) /
-		((1.0 / a.mass()) + (1.0 / b.mass()) + (a.invInertia() * a_RxN * a_RxN + b.invInertia() * b_RxN * b_RxN));
+	Point<Real> a_R = { contact.point.x - a.xPos(), contact.point.y - a.yPos() };
+	Real a_RxN = cross(a_R, contact.normal);
+	Point<Real> a_velTotal = { a.xVelocity() - a.angleVelocity() * a_R.y, a.yVelocity() + a.angleVelocity() * a_R.x};
+	Point<Real> b_R = { contact.point.x - b.xPos(), contact.point.y - b.yPos() };
+	Real b_RxN = cross(b_R, contact.normal);
+	Point<Real> b_VelTotal = { b.xVelocity() - b.angleVelocity() * b_R.y, b.yVelocity() + b.angleVelocity() * b_R.x };
 
-	double a_angleVel = a.angleVelocity() + a.invInertia() * a_RxN * impulse;
-	double a_xVel = a.xVelocity() + (impulse / a.mass()) * collision.Normal.x;
-	double a_yVel = a.yVelocity() + (impulse / a.mass()) * collision.Normal.y;
-	double b_angleVel = b.angleVelocity() - b.invInertia() * b_RxN * impulse;
-	double b_xVel = b.xVelocity() - (impulse / b.mass()) * collision.Normal.x;
-	double b_yVel = b.yVelocity() - (impulse / b.mass()) * collision.Normal.y;
+	Real approach = dot({ a_velTotal.x - b_VelTotal.x, a_velTotal.y - b_VelTotal.y }, contact.normal);
+	if (approach >= 0)
+		return;
+	Real impulse = -(1 + C_R) * approach /
+		((1 / a.mass()) + (1 / b.mass()) + (a.invInertia() * a_RxN * a_RxN + b.invInertia() * b_RxN * b_RxN));
+
+	Real a_angleVel = a.angleVelocity() + a.invInertia() * a_RxN * impulse;
+	Real a_xVel = a.xVelocity() + (impulse / a.mass()) * contact.normal.x;
+	Real a_yVel = a.yVelocity() + (impulse / a.mass()) * contact.normal.y;
+	Real b_angleVel = b.angleVelocity() - b.invInertia() * b_RxN * impulse;
+	Real b_xVel = b.xVelocity() - (impulse / b.mass()) * contact.normal.x;
+	Real b_yVel = b.yVelocity() - (impulse / b.mass()) * contact.normal.y;
 
 	a.setVelocity(a_xVel, a_yVel, a_angleVel);
 	b.setVelocity(b_xVel, b_yVel, b_angleVel);
-	a.addPolygonColission(b);
-	b.addPolygonColission(a);
 }
 
-void CollisionManager::resolveCollisions(std::vector<Polygon>& polygons)
-{	// simple collision optimization, uniform grid space partitioning
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::correctPosition(Polygon<Real>& a, Polygon<Real>& b, const Contact& contact) const
+{	// Split impulse: a pseudo impulse along the contact normal moves and turns the bodies but never touches
+	// their velocities, so removing overlap adds no energy. Heavier bodies move less.
+	Real correction = _baumgarte * (contact.depth - _slop);
+	if (correction <= 0)
+		return;
 
-	static const auto columnWidth = _width * 1.0 / _columns;
-	static const auto rowHeight = _height * 1.0 / _rows;
+	Point<Real> a_R = { contact.point.x - a.xPos(), contact.point.y - a.yPos() };
+	Point<Real> b_R = { contact.point.x - b.xPos(), contact.point.y - b.yPos() };
+	Real a_RxN = cross(a_R, contact.normal);
+	Real b_RxN = cross(b_R, contact.normal);
+	Real pseudoImpulse = correction /
+		((1 / a.mass()) + (1 / b.mass()) + (a.invInertia() * a_RxN * a_RxN + b.invInertia() * b_RxN * b_RxN));
 
-	// Add polygons to collision grids
-	for (auto& polygon : polygons) {
-		for (int i = 0; i < _rows; i++) {
-			auto top = i * rowHeight;
-			auto bottom = (i + 1) * rowHeight;
-			bool withinTopToBottom = (polygon.yPos() + polygon.vertexRadius() > top)
-				&& (polygon.yPos() - polygon.vertexRadius() < bottom);
-			if (!withinTopToBottom)
-				continue;
+	a.setPosition(a.xPos() + (pseudoImpulse / a.mass()) * contact.normal.x, a.yPos() + (pseudoImpulse / a.mass()) * contact.normal.y);
+	a.setAngle(a.angle() + a.invInertia() * a_RxN * pseudoImpulse);
+	b.setPosition(b.xPos() - (pseudoImpulse / b.mass()) * contact.normal.x, b.yPos() - (pseudoImpulse / b.mass()) * contact.normal.y);
+	b.setAngle(b.angle() - b.invInertia() * b_RxN * pseudoImpulse);
+}
 
-			for (int j = 0; j < _columns; j++) {
-				auto left = j * columnWidth;
-				auto right = (j + 1) * columnWidth;
-				bool withinLeftToRight = (polygon.xPos() + polygon.vertexRadius() > left)
-					&& (polygon.xPos() - polygon.vertexRadius() < right);
-				if (!withinLeftToRight)
-					continue;
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::resolveCollisions(std::vector<Polygon<Real>>& polygons)
+{	// Broadphase fills a flat pair buffer, the narrowphase then works through it in batches
+	if (polygons.size() >= MaxBodies)
+		throw std::length_error("CollisionManager: too many bodies for the pair buffer");
+	_frameArena.reset();
+	if (bodyOrderDegraded(polygons))
+		sortBodies(polygons);
 
-				int gridBox = i * _rows + j;
-				_collisionGrid[gridBox].push_back(&polygon);
-			}
+	// Only the collision grid wraps round, the other grids stand in for it while an axis is periodic
+	auto broadphase = _broadphase;
+	if ((_periodicX || _periodicY) && broadphase != VerletList)
+		broadphase = UniformGrid;
+	if (_adaptiveGrid && (broadphase == UniformGrid || broadphase == VerletList))
+		fitCollisionGrid(polygons);
+
+	auto pairs = _frameArena.vector<PairKey>();
+	pairs.reserve(2 * polygons.size());
+	switch (broadphase)
+	{
+	case VerletList:
+		verletListPairs(polygons, pairs);
+		break;
+	case LooseGrid:
+		looseGridPairs(polygons, pairs);
+		break;
+	case HierarchicalGrid:
+		hierarchicalGridPairs(polygons, pairs);
+		break;
+	case HashedGrid:
+		hashedGridPairs(polygons, pairs);
+		break;
+	default:
+		uniformGridPairs(polygons, pairs);
+		break;
+	}
+	auto seam = _frameArena.vector<PairKey>();
+	splitSeamPairs(polygons, 0, pairs, seam);
+
+	auto bodies = gatherBodies(polygons);
+	filterPairs(bodies, pairs);
+	narrowphase(polygons, bodies, pairs);
+	seamCollisions(polygons, bodies, seam);
+	wallCollisions(polygons, bodies);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::resolveSubstepped(std::vector<Polygon<Real>>& polygons, Real dt, int substeps)
+{	// XPBD style: one broadphase per step with bounds grown by how far bodies can get,
+	// then per substep one position projection per touching pair, walls, static shapes and integration
+	if (polygons.size() >= MaxBodies)
+		throw std::length_error("CollisionManager: too many bodies for the pair buffer");
+	_frameArena.reset();
+	if (bodyOrderDegraded(polygons))
+		sortBodies(polygons);
+	if (_adaptiveGrid)
+		fitCollisionGrid(polygons);
+
+	// Collisions during the step can speed a body up, allow for twice the fastest one
+	double maxSpeed = 0;
+	for (auto& polygon : polygons)
+		maxSpeed = max(maxSpeed, sqrt(double(polygon.xVelocity() * polygon.xVelocity() + polygon.yVelocity() * polygon.yVelocity())));
+	auto pairs = _frameArena.vector<PairKey>();
+	expandedPairs(polygons, 2 * maxSpeed * dt, pairs);
+	auto seam = _frameArena.vector<PairKey>();
+	splitSeamPairs(polygons, 2 * maxSpeed * dt, pairs, seam);
+	sortPairs(pairs);
+
+	Real h = dt / substeps;
+	auto rotations = _frameArena.vector<Point<Narrow>>();
+	rotations.resize(polygons.size());
+	for (int substep = 0; substep < substeps; substep++) {
+		for (int i = 0; i < polygons.size(); i++)
+			rotations[i] = { Narrow(cos(polygons[i].angle())), Narrow(sin(polygons[i].angle())) };
+
+		int begin = 0;
+		while (begin < pairs.size()) {
+			int end = begin + 1;
+			while (end < pairs.size() && pairs[end] >> 48 == pairs[begin] >> 48)
+				end++;
+			projectBatch(polygons, rotations, pairs, begin, end, h);
+			begin = end;
+		}
+		for (auto pair : seam) {
+			auto& a = polygons[pairBodyA(pair)];
+			auto& b = polygons[pairBodyB(pair)];
+			auto shift = imageShift(a, b);
+			Point<Real> before = { b.xPos(), b.yPos() };
+			shiftBody(b, shift);
+			Real depth;
+			if (rad_collided(a, b) && sat_collided(a, b, &depth))
+				projectContact(a, b, depth, h);
+			restoreBody(b, before, shift);
+		}
+
+		for (auto& polygon : polygons) {
+			wallCollisionHandling(polygon);
+			staticCollisionHandling(polygon);
+			polygon.updatePosition(h);
 		}
 	}
 
-	// Resolve collisions
-	for (auto& box : _collisionGrid) {
-		gridCollisions(box);
-		box.clear();
+	// Wrapped once at the end, so the step's pairs keep the same sides of the seam through every substep
+	for (auto& polygon : polygons)
+		wrapPosition(polygon);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setBroadphase(Broadphase_Method method, double verletSkin)
+{
+	_broadphase = method;
+	_verletSkin = verletSkin;
+	_verletPairs.clear();
+	_verletPositions.clear();
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setWalls(bool enabled)
+{	// Without walls the world is unbounded, pair it with the hashed grid
+	_walls = enabled;
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::walls() const
+{
+	return _walls;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setPeriodic(bool x, bool y)
+{	// The walls of a periodic axis are gone and pairs are tested across its edges with the nearest copy of each body.
+	// Bodies should stay under a quarter of a periodic side, so a pair only ever touches across one edge.
+	_periodicX = x;
+	_periodicY = y;
+	_verletPositions.clear();
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::periodicX() const
+{
+	return _periodicX;
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::periodicY() const
+{
+	return _periodicY;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::wrapPosition(Polygon<Real>& p) const
+{	// Corners are moved along right away, later pair tests read them before the next integration
+	Real x = p.xPos();
+	Real y = p.yPos();
+	if (_periodicX)
+		x -= _width * floor(x / _width);
+	if (_periodicY)
+		y -= _height * floor(y / _height);
+	if (x != p.xPos() || y != p.yPos())
+	{
+		p.setPosition(x, y);
+		p.updatePosition(0);
 	}
 }
 
-bool CollisionManager::sat_collided(Polygon& a, Polygon& b, SAT_Method handling) const
-{	//Seperating Axis Theorem
-	double minOverlap = std::numeric_limits<double>::max();
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setStaticGeometry(const StaticGeometry<Real>& geometry)
+{	// Built once here, the shapes never change afterwards
+	_staticGeometry = geometry;
+	_staticGeometry.build();
+}
+
+template<typename Real, typename Narrow>
+const StaticGeometry<Real>& CollisionManager<Real, Narrow>::staticGeometry() const
+{
+	return _staticGeometry;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setFastMath(bool enabled)
+{	// Approximate normals and unit vectors, see LinearAlgebra::inverseSqrt for the error bound
+	_fastMath = enabled;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setPositionCorrection(Real baumgarte, Real slop)
+{	// baumgarte is the share of the overlap beyond slop removed each step, 1 removes all of it at once
+	_baumgarte = baumgarte;
+	_slop = slop;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setReorderInterval(int frames)
+{	// 0 keeps bodies in the order they were added. Otherwise bodies move around in the vector every few frames,
+	// and each move copies the body's shape, so reorder frames allocate.
+	_reorderInterval = frames;
+	_framesSinceReorder = 0;
+}
+
+template<typename Real, typename Narrow>
+int CollisionManager<Real, Narrow>::reorders() const
+{
+	return _reorders;
+}
 
-	Point prev = a.vertices().back();
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::setThreads(int threads)
+{	// Narrowphase chunks and contact colours are fixed by the bodies alone, so the result does not depend on the thread count
+	_threadPool.reset(new ThreadPool(max(1, threads)));
+}
+
+template<typename Real, typename Narrow>
+ThreadPool& CollisionManager<Real, Narrow>::threadPool()
+{	// Shared with the other per step stages of the world
+	return *_threadPool;
+}
+
+template<typename Real, typename Narrow>
+const FrameArena& CollisionManager<Real, Narrow>::frameArena() const
+{
+	return _frameArena;
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::sat_collided(Polygon<Real>& a, Polygon<Real>& b, Real* depth) const
+{	//Seperating Axis Theorem, detection only, depth gets the smallest overlap
+	Real minOverlap = std::numeric_limits<Real>::max();
+
+	Point<Real> prev = a.vertices().back();
 	for (auto& vertex : a.vertices()) {
-		auto n = normal(vertex, prev);
+		auto n = normal(vertex, prev, _fastMath);
 		auto aProj = project(a.vertices(), n);
 		auto bProj = project(b.vertices(), n);
 
@@ -199,7 +561,7 @@ bool CollisionManager::sat_collided(Polygon& a, Polygon& b, SAT_Method handling)
 
 	prev = b.vertices().back();
 	for (auto& vertex : b.vertices()) {
-		auto n = normal(vertex, prev);
+		auto n = normal(vertex, prev, _fastMath);
 		auto aProj = project(a.vertices(), n);
 		auto bProj = project(b.vertices(), n);
 
@@ -210,27 +572,19 @@ bool CollisionManager::sat_collided(Polygon& a, Polygon& b, SAT_Method handling)
 		prev = vertex;
 	}
 
-	if (handling == WithOverlapRemoval) 
-	{
-		Point d = { b.xPos() - a.xPos(), b.yPos() - a.yPos() };
-		double length = sqrt(d.x * d.x + d.y * d.y);
-		d.x /= length;
-		d.y /= length;
-		
-		a.setPosition(a.xPos() - 0.5 * d.x * minOverlap, a.yPos() - 0.5 * d.y * minOverlap);
-		b.setPosition(b.xPos() + 0.5 * d.x * minOverlap, b.yPos() + 0.5 * d.y * minOverlap);
-	}
-
+	if (depth)
+		*depth = minOverlap;
 	return true;
 }
 
-bool CollisionManager::rad_collided(Polygon& a, Polygon& b) const
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::rad_collided(Polygon<Real>& a, Polygon<Real>& b) const
 {
-	double dx = a.xPos() - b.xPos();
-	double dy = a.yPos() - b.yPos();
-	double dSquared = dx * dx + dy * dy;
-	double rSum = a.vertexRadius() + b.vertexRadius();
-	double rSquared = rSum * rSum;
+	Real dx = a.xPos() - b.xPos();
+	Real dy = a.yPos() - b.yPos();
+	Real dSquared = dx * dx + dy * dy;
+	Real rSum = a.vertexRadius() + b.vertexRadius();
+	Real rSquared = rSum * rSum;
 
 	if (dSquared > rSquared)
 		return false;
@@ -238,19 +592,707 @@ bool CollisionManager::rad_collided(Polygon& a, Polygon& b) const
 		return true;
 }
 
-void CollisionManager::gridCollisions(std::vector<Polygon*>& polygons) const
-{	// Simple iteration, no optimization
-	int size = polygons.size();
-	if (size <= 1) return;
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::uniformGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs)
+{	// Simple iteration per cell, pairs sharing several cells are only reported by the first one
+	auto lists = fillCollisionGrid(polygons, 0);
 
-	for (int i = 0; i < size - 1; i++) {
-		for (int j = i + 1; j < size; j++) {
-			collisionCheckAndResolution(*polygons[i], *polygons[j]);
+	for (int cell = 0; cell < _columns * _rows; cell++) {
+		for (int i = lists.start[cell]; i < lists.start[cell + 1] - 1; i++) {
+			for (int j = i + 1; j < lists.start[cell + 1]; j++) {
+				int a = lists.bodies[i];
+				int b = lists.bodies[j];
+				if (firstSharedCell(lists, a, b, cell))
+					pairs.push_back(pairKey(polygons, a, b));
+			}
 		}
 	}
 }
 
-void CollisionManager::removeOverlap(Polygon& a, Polygon& b) const
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::firstSharedCell(const CellLists& lists, int a, int b, int cell) const
+{
+	auto& aRange = lists.ranges[a];
+	auto& bRange = lists.ranges[b];
+	return cell / _columns == firstSharedSpan(aRange.firstRow, aRange.lastRow, bRange.firstRow, bRange.lastRow, _rows, _periodicY) &&
+		cell % _columns == firstSharedSpan(aRange.firstColumn, aRange.lastColumn, bRange.firstColumn, bRange.lastColumn, _columns, _periodicX);
+}
+
+template<typename Real, typename Narrow>
+int CollisionManager<Real, Narrow>::firstSharedSpan(int aFirst, int aLast, int bFirst, int bLast, int count, bool periodic)
+{	// First row or column two spans share, on a periodic axis also when they meet across the edge
+	if (!periodic)
+		return max(aFirst, bFirst);
+	for (int shift : { 0, -count, count }) {
+		if (max(aFirst, bFirst + shift) <= min(aLast, bLast + shift))
+			return wrapCell(max(aFirst, bFirst + shift), count);
+	}
+	return -1;
+}
+
+template<typename Real, typename Narrow>
+int CollisionManager<Real, Narrow>::wrapCell(int index, int count)
+{	// Spans start inside the grid and are never longer than it, so one subtraction is enough
+	return index < count ? index : index - count;
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::CellRange CollisionManager<Real, Narrow>::cellRange(const Polygon<Real>& p, double margin) const
+{	// Grid cells overlapped by the bounding circle grown by margin, clamped to the grid.
+	// Periodic axes keep the span past the edge instead, moved to start inside the grid and at most once round.
+	double r = p.vertexRadius() + margin;
+	auto span = [&](double low, double high, int count, bool periodic, int& first, int& last) {
+		first = (int)floor(low);
+		last = (int)ceil(high) - 1;
+		if (!periodic)
+		{
+			first = max(0, min(count - 1, first));
+			last = max(0, min(count - 1, last));
+			return;
+		}
+		int shift = first - ((first % count) + count) % count;
+		first -= shift;
+		last = min(last - shift, first + count - 1);
+	};
+
+	CellRange range;
+	span((p.xPos() - r) / _columnWidth, (p.xPos() + r) / _columnWidth, _columns, _periodicX, range.firstColumn, range.lastColumn);
+	span((p.yPos() - r) / _rowHeight, (p.yPos() + r) / _rowHeight, _rows, _periodicY, range.firstRow, range.lastRow);
+	return range;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::resizeCollisionGrid(int columns, int rows)
+{
+	_columns = columns;
+	_rows = rows;
+	_columnWidth = _width * 1.0 / _columns;
+	_rowHeight = _height * 1.0 / _rows;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::fitCollisionGrid(const std::vector<Polygon<Real>>& polygons)
+{	// Cells about twice the median radius, re-picked every second or so
+	const int framesBetweenFits = 60;
+	if (_framesUntilGridFit-- > 0 || polygons.empty())
+		return;
+	_framesUntilGridFit = framesBetweenFits;
+
+	_radii.resize(polygons.size());
+	for (int i = 0; i < polygons.size(); i++)
+		_radii[i] = polygons[i].vertexRadius();
+	auto median = _radii.begin() + _radii.size() / 2;
+	std::nth_element(_radii.begin(), median, _radii.end());
+
+	// No more cells than about two per body, so small bodies in a big world don't create a sea of empty cells
+	double cellSize = max(2 * *median, sqrt(_width * 1.0 * _height / (2.0 * polygons.size())));
+	int columns = max(1, (int)ceil(_width / cellSize));
+	int rows = max(1, (int)ceil(_height / cellSize));
+
+	// Rebuild only when the cell size has drifted noticeably
+	double drift = abs(_width * 1.0 / columns - _columnWidth) / _columnWidth;
+	if (!_gridFitted || drift > 0.25)
+		resizeCollisionGrid(columns, rows);
+	_gridFitted = true;
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::CellLists CollisionManager<Real, Narrow>::fillCollisionGrid(const std::vector<Polygon<Real>>& polygons, double margin)
+{	// Counting sort of the bodies into every cell they cover, all of it in the frame arena
+	CellLists lists = { _frameArena.vector<CellRange>(), _frameArena.vector<int>(), _frameArena.vector<int>() };
+	lists.ranges.resize(polygons.size());
+	lists.start.assign(_columns * _rows + 1, 0);
+
+	for (int index = 0; index < polygons.size(); index++) {
+		auto range = cellRange(polygons[index], margin);
+		lists.ranges[index] = range;
+		for (int i = range.firstRow; i <= range.lastRow; i++)
+			for (int j = range.firstColumn; j <= range.lastColumn; j++)
+				lists.start[wrapCell(i, _rows) * _columns + wrapCell(j, _columns) + 1]++;
+	}
+	for (int cell = 0; cell < _columns * _rows; cell++)
+		lists.start[cell + 1] += lists.start[cell];
+
+	lists.bodies.resize(lists.start.back());
+	for (int index = 0; index < polygons.size(); index++) {
+		auto& range = lists.ranges[index];
+		for (int i = range.firstRow; i <= range.lastRow; i++)
+			for (int j = range.firstColumn; j <= range.lastColumn; j++)
+				lists.bodies[lists.start[wrapCell(i, _rows) * _columns + wrapCell(j, _columns)]++] = index;
+	}
+
+	// Filling shifted every offset one cell forward, shift them back
+	for (int cell = _columns * _rows; cell > 0; cell--)
+		lists.start[cell] = lists.start[cell - 1];
+	lists.start[0] = 0;
+
+	return lists;
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::verletListExpired(const std::vector<Polygon<Real>>& polygons) const
+{	// Pairs stay valid until some body has moved more than half the skin since the build
+	if (_verletPositions.size() != polygons.size())
+		return true;
+
+	double limitSquared = 0.25 * _verletSkin * _verletSkin;
+	for (int i = 0; i < polygons.size(); i++)
+	{
+		auto moved = minimumImage(polygons[i].xPos() - _verletPositions[i].x, polygons[i].yPos() - _verletPositions[i].y);
+		if (moved.x * moved.x + moved.y * moved.y > limitSquared)
+			return true;
+	}
+	return false;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::buildVerletList(const std::vector<Polygon<Real>>& polygons)
+{	// Candidate pairs within radius + skin, found through the grid with bodies grown by half the skin
+	_verletPairs.clear();
+	auto lists = fillCollisionGrid(polygons, 0.5 * _verletSkin);
+
+	for (int cell = 0; cell < _columns * _rows; cell++) {
+		for (int i = lists.start[cell]; i < lists.start[cell + 1] - 1; i++) {
+			for (int j = i + 1; j < lists.start[cell + 1]; j++) {
+				int a = lists.bodies[i];
+				int b = lists.bodies[j];
+				if (!firstSharedCell(lists, a, b, cell))
+					continue;
+
+				auto d = minimumImage(polygons[a].xPos() - polygons[b].xPos(), polygons[a].yPos() - polygons[b].yPos());
+				double reach = polygons[a].vertexRadius() + polygons[b].vertexRadius() + _verletSkin;
+				if (d.x * d.x + d.y * d.y <= reach * reach)
+					_verletPairs.push_back({ a, b });
+			}
+		}
+	}
+
+	_verletPositions.resize(polygons.size());
+	for (int i = 0; i < polygons.size(); i++)
+		_verletPositions[i] = { polygons[i].xPos(), polygons[i].yPos() };
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::expandedPairs(const std::vector<Polygon<Real>>& polygons, double reach, FrameVector<PairKey>& pairs)
+{	// Pairs that can touch after each body moved up to reach, found like the Verlet list build
+	auto lists = fillCollisionGrid(polygons, reach);
+
+	for (int cell = 0; cell < _columns * _rows; cell++) {
+		for (int i = lists.start[cell]; i < lists.start[cell + 1] - 1; i++) {
+			for (int j = i + 1; j < lists.start[cell + 1]; j++) {
+				int a = lists.bodies[i];
+				int b = lists.bodies[j];
+				if (!firstSharedCell(lists, a, b, cell))
+					continue;
+
+				auto d = minimumImage(polygons[a].xPos() - polygons[b].xPos(), polygons[a].yPos() - polygons[b].yPos());
+				double distance = polygons[a].vertexRadius() + polygons[b].vertexRadius() + 2 * reach;
+				if (d.x * d.x + d.y * d.y <= distance * distance)
+					pairs.push_back(pairKey(polygons, a, b));
+			}
+		}
+	}
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::verletListPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs)
+{	// Reuse the neighbour list across frames, rebuild only when it may have missed a pair
+	if (verletListExpired(polygons))
+		buildVerletList(polygons);
+
+	for (auto& pair : _verletPairs)
+		pairs.push_back(pairKey(polygons, pair.first, pair.second));
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::looseGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs)
+{	// Single insertion by center, cells must be at least as large as the largest body
+	double maxRadius = 0;
+	for (auto& polygon : polygons)
+		maxRadius = max(maxRadius, double(polygon.vertexRadius()));
+
+	double cellSize = max(2 * maxRadius, 1.0);
+	if (!_looseGridFitted || cellSize > _looseGrid.cellSize() || cellSize < 0.5 * _looseGrid.cellSize())
+		_looseGrid.resize(_width, _height, cellSize);
+	_looseGridFitted = true;
+
+	_looseGrid.clear();
+	for (int i = 0; i < polygons.size(); i++)
+		_looseGrid.insert(i, polygons[i].xPos(), polygons[i].yPos());
+	_looseGrid.finalize();
+
+	_looseGrid.forEachPair([&](int a, int b) {
+		pairs.push_back(pairKey(polygons, a, b));
+	});
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::hierarchicalGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs)
+{	// Large bodies stay in coarse levels instead of being smeared over many small cells
+	_gridHierarchy.build(polygons);
+	_gridHierarchy.forEachPair([&](int a, int b) {
+		pairs.push_back(pairKey(polygons, a, b));
+	});
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::hashedGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs)
+{	// Same traversal as the loose grid, but only occupied cells take up memory
+	double maxRadius = 0;
+	for (auto& polygon : polygons)
+		maxRadius = max(maxRadius, double(polygon.vertexRadius()));
+
+	double cellSize = max(2 * maxRadius, 1.0);
+	if (cellSize > _spatialHash.cellSize() || cellSize < 0.5 * _spatialHash.cellSize())
+		_spatialHash.setCellSize(cellSize);
+
+	_spatialHash.clear();
+	for (int i = 0; i < polygons.size(); i++)
+		_spatialHash.insert(i, polygons[i].xPos(), polygons[i].yPos());
+	_spatialHash.finalize();
+
+	_spatialHash.forEachPair([&](int a, int b) {
+		pairs.push_back(pairKey(polygons, a, b));
+	});
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::PairKey CollisionManager<Real, Narrow>::pairKey(const std::vector<Polygon<Real>>& polygons, int a, int b)
+{	// Fewer corners first, so (3, 5) and (5, 3) pairs land in the same batch
+	int aCorners = polygons[a].nbrOfCorners();
+	int bCorners = polygons[b].nbrOfCorners();
+	if (aCorners > bCorners || (aCorners == bCorners && a > b))
+	{
+		std::swap(a, b);
+		std::swap(aCorners, bCorners);
+	}
+	assert(b < MaxBodies && bCorners < 256);
+	return (PairKey)aCorners << 56 | (PairKey)bCorners << 48 | (PairKey)a << 24 | (PairKey)b;
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::FrameBodies CollisionManager<Real, Narrow>::gatherBodies(std::vector<Polygon<Real>>& polygons)
+{	// Rotation, bounding circle and tight bounding box of every body
+	int n = polygons.size();
+	FrameBodies bounds = { _frameArena.vector<Point<Narrow>>(), _frameArena.vector<double>(), _frameArena.vector<double>(), _frameArena.vector<double>(),
+		_frameArena.vector<double>(), _frameArena.vector<double>(), _frameArena.vector<double>(), _frameArena.vector<double>(),
+		_frameArena.vector<Simd::QuantizedBox>() };
+	bounds.rotation.resize(n);
+	bounds.x.resize(n);
+	bounds.y.resize(n);
+	bounds.radius.resize(n);
+	bounds.minX.resize(n);
+	bounds.minY.resize(n);
+	bounds.maxX.resize(n);
+	bounds.maxY.resize(n);
+	bounds.boxes.resize(n);
+
+	Point<double> worldLow = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+	Point<double> worldHigh = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+	for (int i = 0; i < n; i++) {
+		auto& polygon = polygons[i];
+		bounds.rotation[i] = { Narrow(cos(polygon.angle())), Narrow(sin(polygon.angle())) };
+		bounds.x[i] = polygon.xPos();
+		bounds.y[i] = polygon.yPos();
+		bounds.radius[i] = polygon.vertexRadius();
+
+		Point<Real> low = polygon.vertices().front();
+		Point<Real> high = low;
+		for (auto& vertex : polygon.vertices()) {
+			low = { min(low.x, vertex.x), min(low.y, vertex.y) };
+			high = { max(high.x, vertex.x), max(high.y, vertex.y) };
+		}
+		bounds.minX[i] = low.x;
+		bounds.minY[i] = low.y;
+		bounds.maxX[i] = high.x;
+		bounds.maxY[i] = high.y;
+		worldLow = { min(worldLow.x, double(low.x)), min(worldLow.y, double(low.y)) };
+		worldHigh = { max(worldHigh.x, double(high.x)), max(worldHigh.y, double(high.y)) };
+	}
+
+	// 16 bit boxes over the extent of all bodies, rounded outward so the integer test never drops an overlap
+	const double steps = 65534;
+	double scaleX = steps / max(worldHigh.x - worldLow.x, 1e-9);
+	double scaleY = steps / max(worldHigh.y - worldLow.y, 1e-9);
+	auto quantize = [](double value) { return (short)(value - 32767); };
+	for (int i = 0; i < n; i++) {
+		bounds.boxes[i] = {
+			quantize(floor((bounds.minX[i] - worldLow.x) * scaleX)), quantize(floor((bounds.minY[i] - worldLow.y) * scaleY)),
+			quantize(min(ceil((bounds.maxX[i] - worldLow.x) * scaleX), steps)), quantize(min(ceil((bounds.maxY[i] - worldLow.y) * scaleY), steps)) };
+	}
+	return bounds;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::filterPairs(const FrameBodies& bounds, FrameVector<PairKey>& pairs) const
+{	// Integer box test on 8 bytes per body first, then bounding circle and exact box on the survivors
+	auto& kernels = Simd::kernels<Real>();
+	pairs.resize(kernels.filterBoxes(bounds.boxes.data(), pairs.data(), pairs.size()));
+
+	Simd::PairBounds arrays = { bounds.x.data(), bounds.y.data(), bounds.radius.data(),
+		bounds.minX.data(), bounds.minY.data(), bounds.maxX.data(), bounds.maxY.data() };
+	pairs.resize(kernels.filterPairs(arrays, pairs.data(), pairs.size()));
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::narrowphase(std::vector<Polygon<Real>>& polygons, FrameBodies& bodies, FrameVector<PairKey>& pairs)
+{	// Sorted by corner counts then body index, so each batch only ever sees one kind of shape pair.
+	// Detection only reads the bodies, so fixed chunks of pairs run on any thread. Every pair gets a slot,
+	// and the contacts are collected in pair order, the same order whatever the thread count.
+	sortPairs(pairs);
+
+	auto slots = _frameArena.vector<Contact>();
+	slots.resize(pairs.size());
+	int size = pairs.size();
+	_threadPool->run((size + NarrowphaseChunk - 1) / NarrowphaseChunk, [&](int task) {
+		int begin = task * NarrowphaseChunk;
+		int last = min(size, begin + NarrowphaseChunk);
+		while (begin < last) {
+			int end = begin + 1;
+			while (end < last && pairs[end] >> 48 == pairs[begin] >> 48)
+				end++;
+			narrowphaseBatch(polygons, bodies, pairs, begin, end, slots.data());
+			begin = end;
+		}
+	});
+
+	auto contacts = _frameArena.vector<Contact>();
+	for (auto& found : slots) {
+		if (found.a >= 0)
+			contacts.push_back(found);
+	}
+
+	// Velocities first, then the split impulse position pass, one colour at a time
+	solveContacts(polygons, bodies, colourContacts(contacts, polygons.size()));
+
+	// The wall pass reads the centers after the narrowphase
+	for (auto& found : contacts) {
+		bodies.x[found.a] = polygons[found.a].xPos();
+		bodies.y[found.a] = polygons[found.a].yPos();
+		bodies.x[found.b] = polygons[found.b].xPos();
+		bodies.y[found.b] = polygons[found.b].yPos();
+	}
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::ContactColours CollisionManager<Real, Narrow>::colourContacts(const FrameVector<Contact>& contacts, int bodies)
+{	// Greedy colouring in contact order, each contact takes the lowest colour neither body has used yet
+	auto used = _frameArena.vector<unsigned long long>();
+	used.assign(bodies, 0);
+	auto colour = _frameArena.vector<int>();
+	colour.resize(contacts.size());
+	int count[MaxColours + 1] = {};
+	for (int i = 0; i < contacts.size(); i++) {
+		unsigned long long taken = used[contacts[i].a] | used[contacts[i].b];
+		int c = 0;
+		while (c < MaxColours && (taken >> c & 1))
+			c++;
+		if (c < MaxColours) {
+			used[contacts[i].a] |= 1ull << c;
+			used[contacts[i].b] |= 1ull << c;
+		}
+		colour[i] = c;
+		count[c]++;
+	}
+
+	ContactColours colours = { _frameArena.vector<Contact>(), _frameArena.vector<int>(), count[MaxColours] > 0 };
+	colours.start.push_back(0);
+	for (int c = 0; c <= MaxColours; c++) {
+		if (count[c] == 0)
+			continue;
+		int padded = (count[c] + ContactLanes - 1) / ContactLanes * ContactLanes;
+		colours.start.push_back(colours.start.back() + padded);
+	}
+
+	Contact padding = {};
+	padding.a = -1;
+	padding.b = -1;
+	colours.contacts.assign(colours.start.back(), padding);
+	int fill[MaxColours + 1];
+	for (int c = 0, slot = 0; c <= MaxColours; c++) {
+		if (count[c] > 0)
+			fill[c] = colours.start[slot++];
+	}
+	for (int i = 0; i < contacts.size(); i++)
+		colours.contacts[fill[colour[i]]++] = contacts[i];
+	return colours;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::solveContacts(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies, const ContactColours& colours)
+{	// Gauss-Seidel inside a colour is free to run on any thread, returning from run is the barrier between colours.
+	// The overflow colour can share bodies, so it stays one task.
+	// Velocities are solved a SIMD row of contacts at a time on velocities gathered from the bodies,
+	// the split impulse position pass then works on the bodies one contact at a time.
+	if (colours.contacts.empty())
+		return;
+
+	const Real C_R = 1;		//Coefficient of restitution, same as collisionResolution
+	int lastColour = colours.start.size() - 2;
+	auto pass = [&](auto solve) {
+		for (int c = 0; c <= lastColour; c++) {
+			int begin = colours.start[c];
+			int end = colours.start[c + 1];
+			int chunk = (c == lastColour && colours.overflow) ? end - begin : 16 * ContactLanes;
+			_threadPool->run((end - begin + chunk - 1) / chunk, [&](int task) {
+				solve(begin + task * chunk, min(end, begin + (task + 1) * chunk));
+			});
+		}
+	};
+
+	int count = colours.contacts.size();
+	ContactRows rows = { _frameArena.vector<int>(), _frameArena.vector<int>(), _frameArena.vector<Real>(), _frameArena.vector<Real>(),
+		_frameArena.vector<Real>(), _frameArena.vector<Real>(), _frameArena.vector<Real>() };
+	rows.a.resize(count);
+	rows.b.resize(count);
+	rows.normalX.resize(count);
+	rows.normalY.resize(count);
+	rows.aRxN.resize(count);
+	rows.bRxN.resize(count);
+	rows.normalMass.resize(count);
+	auto velocities = gatherVelocities(polygons);
+
+	auto& kernels = Simd::kernels<Real>();
+	Simd::ContactRows<Real> rowArrays = { rows.a.data(), rows.b.data(), rows.normalX.data(), rows.normalY.data(),
+		rows.aRxN.data(), rows.bRxN.data(), rows.normalMass.data() };
+	Simd::BodyVelocities<Real> velocityArrays = { velocities.x.data(), velocities.y.data(), velocities.angle.data(),
+		velocities.invMass.data(), velocities.invInertia.data() };
+	pass([&](int first, int last) {
+		fillContactRows(bodies, velocities, colours, first, last, rows);
+		solveContactRows(kernels, colours, rowArrays, velocityArrays, first, last, C_R);
+	});
+	for (int i = 0; i < polygons.size(); i++)
+		polygons[i].setVelocity(velocities.x[i], velocities.y[i], velocities.angle[i]);
+
+	pass([&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			auto& found = colours.contacts[i];
+			if (found.a >= 0)
+				correctPosition(polygons[found.a], polygons[found.b], found);
+		}
+	});
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::solveContactRows(const Simd::Kernels<Real>& kernels, const ContactColours& colours, const Simd::ContactRows<Real>& rows,
+	const Simd::BodyVelocities<Real>& velocities, int first, int last, Real restitution)
+{	// Contacts in the overflow colour share bodies, the vector lanes would overwrite each other's impulses
+	if (colours.overflow && first >= colours.start[colours.start.size() - 2])
+		Simd::solveContactRowsTail(rows, velocities, first, last, restitution);
+	else
+		kernels.solveContactRows(rows, velocities, first, last, restitution);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::fillContactRows(const FrameBodies& bodies, const BodyVelocities& velocities, const ContactColours& colours, int first, int last, ContactRows& rows) const
+{	// Lever arms folded into the normal once, the bodies do not move during the velocity pass.
+	// Reads the frame's arrays only, never the bodies themselves.
+	int spare = bodies.x.size();
+	for (int i = first; i < last; i++) {
+		auto& found = colours.contacts[i];
+		if (found.a < 0) {
+			rows.a[i] = spare;
+			rows.b[i] = spare;
+			rows.normalX[i] = rows.normalY[i] = rows.aRxN[i] = rows.bRxN[i] = rows.normalMass[i] = 0;
+			continue;
+		}
+		int a = found.a;
+		int b = found.b;
+		Real a_RxN = cross({ found.point.x - Real(bodies.x[a]), found.point.y - Real(bodies.y[a]) }, found.normal);
+		Real b_RxN = cross({ found.point.x - Real(bodies.x[b]), found.point.y - Real(bodies.y[b]) }, found.normal);
+		rows.a[i] = a;
+		rows.b[i] = b;
+		rows.normalX[i] = found.normal.x;
+		rows.normalY[i] = found.normal.y;
+		rows.aRxN[i] = a_RxN;
+		rows.bRxN[i] = b_RxN;
+		rows.normalMass[i] = 1 / (velocities.invMass[a] + velocities.invMass[b] +
+			(velocities.invInertia[a] * a_RxN * a_RxN + velocities.invInertia[b] * b_RxN * b_RxN));
+	}
+}
+
+template<typename Real, typename Narrow>
+typename CollisionManager<Real, Narrow>::BodyVelocities CollisionManager<Real, Narrow>::gatherVelocities(const std::vector<Polygon<Real>>& polygons)
+{	// The spare body at the end takes the padding entries' zero impulses
+	int count = polygons.size();
+	BodyVelocities velocities = { _frameArena.vector<Real>(), _frameArena.vector<Real>(), _frameArena.vector<Real>(),
+		_frameArena.vector<Real>(), _frameArena.vector<Real>() };
+	velocities.x.resize(count + 1);
+	velocities.y.resize(count + 1);
+	velocities.angle.resize(count + 1);
+	velocities.invMass.resize(count + 1);
+	velocities.invInertia.resize(count + 1);
+	for (int i = 0; i < count; i++) {
+		velocities.x[i] = polygons[i].xVelocity();
+		velocities.y[i] = polygons[i].yVelocity();
+		velocities.angle[i] = polygons[i].angleVelocity();
+		velocities.invMass[i] = 1 / polygons[i].mass();
+		velocities.invInertia[i] = polygons[i].invInertia();
+	}
+	velocities.x[count] = velocities.y[count] = velocities.angle[count] = 0;
+	velocities.invMass[count] = velocities.invInertia[count] = 0;
+	return velocities;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::sortPairs(FrameVector<PairKey>& pairs)
+{	// LSD radix sort one byte at a time, skipping bytes every key shares (high bytes of small indices)
+	if (pairs.size() < 2)
+		return;
+
+	auto scratch = _frameArena.vector<PairKey>();
+	scratch.resize(pairs.size());
+	PairKey* from = pairs.data();
+	PairKey* to = scratch.data();
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		int count[257] = {};
+		for (int i = 0; i < pairs.size(); i++)
+			count[((from[i] >> shift) & 0xFF) + 1]++;
+		if (count[((from[0] >> shift) & 0xFF) + 1] == pairs.size())
+			continue;
+
+		for (int digit = 0; digit < 256; digit++)
+			count[digit + 1] += count[digit];
+		for (int i = 0; i < pairs.size(); i++)
+			to[count[(from[i] >> shift) & 0xFF]++] = from[i];
+		std::swap(from, to);
+	}
+
+	if (from != pairs.data())
+		std::copy(from, from + pairs.size(), pairs.data());
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::narrowphaseBatch(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies, const FrameVector<PairKey>& pairs, int begin, int end, Contact* slots) const
+{	// Pairs arrive already filtered on bounding circles and boxes, and all share the same corner counts.
+	// Each pair writes its own slot, a = -1 when the shapes do not touch.
+	auto kernel = SatKernels::kernel<Narrow>(pairs[begin] >> 56, (pairs[begin] >> 48) & 0xFF);
+	Point<Narrow> aScratch[SatKernels::MaxCorners];
+	Point<Narrow> bScratch[SatKernels::MaxCorners];
+
+	for (int i = begin; i < end; i++) {
+		int aIndex = pairBodyA(pairs[i]);
+		int bIndex = pairBodyB(pairs[i]);
+		auto& a = polygons[aIndex];
+		auto& b = polygons[bIndex];
+		slots[i].a = -1;
+
+		Real depth;
+		if (kernel)
+		{
+			auto aCorners = narrowCorners(a.vertices(), a, aScratch);
+			auto bCorners = narrowCorners(b.vertices(), a, bScratch);
+			Narrow minOverlap = std::numeric_limits<Narrow>::max();
+			if (!kernel(aCorners, bodies.rotation[aIndex], bCorners, bodies.rotation[bIndex], minOverlap))
+				continue;
+			depth = minOverlap;
+		}
+		else if (!sat_collided(a, b, &depth))
+			continue;
+
+		slots[i] = contact(a, b, aIndex, bIndex, depth);
+	}
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::wallCollisions(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies)
+{	// One vector pass over centers and radii, only bodies whose circle crosses a wall get the vertex scans
+	if (!_walls || (_periodicX && _periodicY))
+		return;
+
+	auto crossing = _frameArena.vector<int>();
+	crossing.resize(polygons.size());
+	crossing.resize(Simd::kernels<Real>().filterWalls(bodies.x.data(), bodies.y.data(), bodies.radius.data(),
+		polygons.size(), _width, _height, crossing.data()));
+	for (int body : crossing)
+		wallCollisionHandling(polygons[body]);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::projectBatch(std::vector<Polygon<Real>>& polygons, const FrameVector<Point<Narrow>>& rotations, const FrameVector<PairKey>& pairs, int begin, int end, Real h)
+{	// Same batching as the narrowphase, but the pairs come straight from the step's broadphase
+	auto kernel = SatKernels::kernel<Narrow>(pairs[begin] >> 56, (pairs[begin] >> 48) & 0xFF);
+	Point<Narrow> aScratch[SatKernels::MaxCorners];
+	Point<Narrow> bScratch[SatKernels::MaxCorners];
+
+	for (int i = begin; i < end; i++) {
+		int aIndex = pairBodyA(pairs[i]);
+		int bIndex = pairBodyB(pairs[i]);
+		auto& a = polygons[aIndex];
+		auto& b = polygons[bIndex];
+		if (!rad_collided(a, b))
+			continue;
+
+		Real depth;
+		if (kernel)
+		{
+			auto aCorners = narrowCorners(a.vertices(), a, aScratch);
+			auto bCorners = narrowCorners(b.vertices(), a, bScratch);
+			Narrow minOverlap = std::numeric_limits<Narrow>::max();
+			if (!kernel(aCorners, rotations[aIndex], bCorners, rotations[bIndex], minOverlap))
+				continue;
+			depth = minOverlap;
+		}
+		else if (!sat_collided(a, b, &depth))
+			continue;
+
+		projectContact(a, b, depth, h);
+	}
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::projectContact(Polygon<Real>& a, Polygon<Real>& b, Real depth, Real h) const
+{	// Move both bodies apart by depth, split by their inverse masses at the contact point.
+	// The move shows up in the velocities, then restitution sets the normal velocity from the one before.
+	auto found = contact(a, b, 0, 0, depth);
+	Real C_R = 1;
+	Point<Real> n = found.normal;
+
+	Point<Real> a_R = { found.point.x - a.xPos(), found.point.y - a.yPos() };
+	Point<Real> b_R = { found.point.x - b.xPos(), found.point.y - b.yPos() };
+	Real a_RxN = cross(a_R, n);
+	Real b_RxN = cross(b_R, n);
+	Real w = 1 / a.mass() + 1 / b.mass() + a.invInertia() * a_RxN * a_RxN + b.invInertia() * b_RxN * b_RxN;
+	auto normalVelocity = [&]() {
+		Point<Real> a_velTotal = { a.xVelocity() - a.angleVelocity() * a_R.y, a.yVelocity() + a.angleVelocity() * a_R.x };
+		Point<Real> b_velTotal = { b.xVelocity() - b.angleVelocity() * b_R.y, b.yVelocity() + b.angleVelocity() * b_R.x };
+		return dot({ a_velTotal.x - b_velTotal.x, a_velTotal.y - b_velTotal.y }, n);
+	};
+	auto apply = [&](Real impulse, Real scale) {
+		a.setVelocity(a.xVelocity() + scale * impulse / a.mass() * n.x, a.yVelocity() + scale * impulse / a.mass() * n.y,
+			a.angleVelocity() + scale * a.invInertia() * a_RxN * impulse);
+		b.setVelocity(b.xVelocity() - scale * impulse / b.mass() * n.x, b.yVelocity() - scale * impulse / b.mass() * n.y,
+			b.angleVelocity() - scale * b.invInertia() * b_RxN * impulse);
+	};
+
+	Real normalVelocityBefore = normalVelocity();
+	Real lambda = depth / w;
+	a.setPosition(a.xPos() + lambda / a.mass() * n.x, a.yPos() + lambda / a.mass() * n.y);
+	a.setAngle(a.angle() + a.invInertia() * a_RxN * lambda);
+	b.setPosition(b.xPos() - lambda / b.mass() * n.x, b.yPos() - lambda / b.mass() * n.y);
+	b.setAngle(b.angle() - b.invInertia() * b_RxN * lambda);
+	apply(lambda, 1 / h);
+
+	// Already separating pairs keep their speed, only the projection's share is taken back out
+	Real target = normalVelocityBefore < 0 ? -C_R * normalVelocityBefore : normalVelocityBefore;
+	apply((target - normalVelocity()) / w, 1);
+}
+
+template<typename Real, typename Narrow>
+int CollisionManager<Real, Narrow>::pairBodyA(PairKey pair)
+{
+	return (pair >> 24) & 0xFFFFFF;
+}
+
+template<typename Real, typename Narrow>
+int CollisionManager<Real, Narrow>::pairBodyB(PairKey pair)
+{
+	return pair & 0xFFFFFF;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::removeOverlap(Polygon<Real>& a, Polygon<Real>& b) const
 {
 	auto dx = a.xPos() - b.xPos();
 	auto dy = a.yPos() - b.yPos();
@@ -263,22 +1305,109 @@ void CollisionManager::removeOverlap(Polygon& a, Polygon& b) const
 	b.setPosition(b.xPos() - xPenetration * 0.5, b.yPos() - yPenetration * 0.5);
 }
 
-const CollisionData& CollisionManager::collisionData(Polygon& a, Polygon& b) const
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::splitSeamPairs(const std::vector<Polygon<Real>>& polygons, double reach, FrameVector<PairKey>& pairs, FrameVector<PairKey>& seam)
+{	// Pairs that only touch across a periodic edge leave the batched narrowphase, whose filters see plain coordinates.
+	// Their bounding circles, grown by reach, are tested here instead and they are sorted like the rest, so the seam
+	// pairs never depend on the broadphase.
+	if (!_periodicX && !_periodicY)
+		return;
+
+	int kept = 0;
+	for (auto pair : pairs) {
+		auto& a = polygons[pairBodyA(pair)];
+		auto& b = polygons[pairBodyB(pair)];
+		auto shift = imageShift(a, b);
+		if (shift.x == 0 && shift.y == 0)
+		{
+			pairs[kept++] = pair;
+			continue;
+		}
+		auto d = minimumImage(a.xPos() - b.xPos(), a.yPos() - b.yPos());
+		double rSum = a.vertexRadius() + b.vertexRadius() + 2 * reach;
+		if (d.x * d.x + d.y * d.y <= rSum * rSum)
+			seam.push_back(pair);
+	}
+	pairs.resize(kept);
+	sortPairs(seam);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::seamCollisions(std::vector<Polygon<Real>>& polygons, FrameBodies& bodies, const FrameVector<PairKey>& seam) const
+{	// b moves next to a for the test and the response, then back. The seam is thin, so these run in pair order
+	// after the coloured contacts.
+	for (auto pair : seam) {
+		int aIndex = pairBodyA(pair);
+		int bIndex = pairBodyB(pair);
+		auto& a = polygons[aIndex];
+		auto& b = polygons[bIndex];
+		auto shift = imageShift(a, b);
+		Point<Real> before = { b.xPos(), b.yPos() };
+		shiftBody(b, shift);
+		collisionCheckAndResolution(a, b);
+		restoreBody(b, before, shift);
+
+		bodies.x[aIndex] = a.xPos();
+		bodies.y[aIndex] = a.yPos();
+		bodies.x[bIndex] = b.xPos();
+		bodies.y[bIndex] = b.yPos();
+	}
+}
+
+template<typename Real, typename Narrow>
+Point<double> CollisionManager<Real, Narrow>::minimumImage(double dx, double dy) const
+{	// Shortest displacement between two points, across the edges of periodic axes
+	if (_periodicX)
+		dx -= _width * floor(dx / _width + 0.5);
+	if (_periodicY)
+		dy -= _height * floor(dy / _height + 0.5);
+	return { dx, dy };
+}
+
+template<typename Real, typename Narrow>
+Point<Real> CollisionManager<Real, Narrow>::imageShift(const Polygon<Real>& a, const Polygon<Real>& b) const
+{	// Whole world sizes that take b to its copy nearest a, zero on walled axes
+	Point<Real> shift = { 0, 0 };
+	if (_periodicX)
+		shift.x = Real(-_width * floor((b.xPos() - a.xPos()) / _width + 0.5));
+	if (_periodicY)
+		shift.y = Real(-_height * floor((b.yPos() - a.yPos()) / _height + 0.5));
+	return shift;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::shiftBody(Polygon<Real>& p, Point<Real> shift)
+{	// Moves the corners too, setPosition alone leaves them for the next integration
+	if (shift.x == 0 && shift.y == 0)
+		return;
+	p.setPosition(p.xPos() + shift.x, p.yPos() + shift.y);
+	p.updatePosition(0);
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::restoreBody(Polygon<Real>& p, Point<Real> before, Point<Real> shift)
+{	// Undoes shiftBody but keeps what the response moved, adding the shift back and forth would round away small moves
+	p.setPosition(before.x + (p.xPos() - (before.x + shift.x)), before.y + (p.yPos() - (before.y + shift.y)));
+	p.updatePosition(0);
+}
+
+template<typename Real, typename Narrow>
+CollisionData<Real> CollisionManager<Real, Narrow>::collisionData(Polygon<Real>& a, Polygon<Real>& b) const
 {
-	auto vertexClosestToOtherCenter = [](Polygon& a, Polygon& b)
-	{
+	auto vertexClosestToOtherCenter = [](Polygon<Real>& a, Polygon<Real>& b)
+	{	// Squared distances order the same way, no sqrt needed
 		int aIndexDeepest = 0;
-		double aVerDisToB = std::numeric_limits<double>::max();
+		Real aVerDisToBSquared = std::numeric_limits<Real>::max();
 		for (int i = 0; i < a.vertices().size(); i++)
 		{
-			double dx = a.vertices()[i].x - b.xPos();
-			double dy = a.vertices()[i].y - b.yPos();
-			double disToB = sqrt(dx * dx + dy * dy);
+			Real dx = a.vertices()[i].x - b.xPos();
+			Real dy = a.vertices()[i].y - b.yPos();
+			Real disToBSquared = dx * dx + dy * dy;
 
-			if (disToB < aVerDisToB)
+			if (disToBSquared < aVerDisToBSquared)
 			{
 				aIndexDeepest = i;
-				aVerDisToB = disToB;
+				aVerDisToBSquared = disToBSquared;
 			}
 		}
 
@@ -289,13 +1418,9 @@ const CollisionData& CollisionManager::collisionData(Polygon& a, Polygon& b) con
 	int bIndexDeepest = vertexClosestToOtherCenter(b, a);
 	auto& bDeepest = b.vertices()[bIndexDeepest];
 
-	auto unitVector = [](Point a, Point b)
+	auto unitVector = [&](Point<Real> a, Point<Real> b)
 	{
-		Point d = { b.x - a.x, b.y - a.y };
-		double length = sqrt(d.x * d.x + d.y * d.y);
-		d.x /= length;
-		d.y /= length;
-		return d;
+		return direction(a, b, _fastMath);
 	};
 	auto centersVector = unitVector({ a.xPos(), a.yPos() }, { b.xPos(), b.yPos() });
 	auto aRelativeVectorOfDeepest = unitVector(aDeepest, { a.xPos(), a.yPos() });
@@ -304,7 +1429,7 @@ const CollisionData& CollisionManager::collisionData(Polygon& a, Polygon& b) con
 	auto aDepthAlignment = abs(dot(aRelativeVectorOfDeepest, centersVector));
 	auto bDepthAlignment = abs(dot(bRelativeVectorOfDeepest, centersVector));
 
-	auto collisionNormal = [](Point aDeepest, Point bDeepest, int bIndexDeepest, Polygon& b) -> Point
+	auto collisionNormal = [&](Point<Real> aDeepest, Point<Real> bDeepest, int bIndexDeepest, Polygon<Real>& b) -> Point<Real>
 	{
 		int nextIndex = bIndexDeepest + 1 < b.vertices().size() ? bIndexDeepest + 1 : 0;
 		const auto& next = b.vertices()[nextIndex];
@@ -312,14 +1437,14 @@ const CollisionData& CollisionManager::collisionData(Polygon& a, Polygon& b) con
 		if (min(bDeepest.x, next.x) <= aDeepest.x && aDeepest.x <= max(bDeepest.x, next.x) &&
 			min(bDeepest.y, next.y) <= aDeepest.y && aDeepest.y <= max(bDeepest.y, next.y))
 		{
-			return normal(next, bDeepest);
+			return normal(next, bDeepest, _fastMath);
 		}
 		else
 		{
 			int prevIndex = bIndexDeepest - 1 >= 0 ? bIndexDeepest - 1 : b.vertices().size() - 1;
 			const auto& prev = b.vertices()[prevIndex];
 
-			return normal(bDeepest, prev);
+			return normal(bDeepest, prev, _fastMath);
 		}
 	};
 
@@ -327,4 +1452,94 @@ const CollisionData& CollisionManager::collisionData(Polygon& a, Polygon& b) con
 		return { aDeepest, collisionNormal(aDeepest, bDeepest, bIndexDeepest, b), false };
 	else
 		return { bDeepest, collisionNormal(bDeepest, aDeepest, aIndexDeepest, a), true };
-}
\ No newline at end of file
+}
+
+template<typename Real, typename Narrow>
+double CollisionManager<Real, Narrow>::storageSpacing(const std::vector<Polygon<Real>>& polygons) const
+{	// Mean distance between bodies stored next to each other, small when memory order follows space
+	double total = 0;
+	for (int i = 0; i + 1 < polygons.size(); i++)
+	{
+		double dx = polygons[i + 1].xPos() - polygons[i].xPos();
+		double dy = polygons[i + 1].yPos() - polygons[i].yPos();
+		total += sqrt(dx * dx + dy * dy);
+	}
+	return total / max(1, (int)polygons.size() - 1);
+}
+
+template<typename Real, typename Narrow>
+bool CollisionManager<Real, Narrow>::bodyOrderDegraded(const std::vector<Polygon<Real>>& polygons)
+{	// Reorder every _reorderInterval frames, or earlier once storage neighbours have drifted apart
+	const int framesBetweenChecks = 10;
+	if (_reorderInterval <= 0 || polygons.size() < 2)
+		return false;
+
+	_framesSinceReorder++;
+	if (_framesSinceReorder >= _reorderInterval)
+		return true;
+	if (_framesSinceReorder % framesBetweenChecks != 0)
+		return false;
+	return storageSpacing(polygons) > 2 * _sortedSpacing;
+}
+
+template<typename Real, typename Narrow>
+void CollisionManager<Real, Narrow>::sortBodies(std::vector<Polygon<Real>>& polygons)
+{	// Store bodies along a Z-order curve so bodies close in space are close in memory
+	int n = polygons.size();
+	double minX = std::numeric_limits<double>::max(), minY = minX;
+	double maxX = std::numeric_limits<double>::lowest(), maxY = maxX;
+	for (auto& polygon : polygons) {
+		minX = min(minX, double(polygon.xPos()));
+		minY = min(minY, double(polygon.yPos()));
+		maxX = max(maxX, double(polygon.xPos()));
+		maxY = max(maxY, double(polygon.yPos()));
+	}
+	double scale = 65535.0 / max(max(maxX - minX, maxY - minY), 1.0);
+
+	auto keys = _frameArena.vector<std::pair<unsigned int, int>>();
+	keys.resize(n);
+	for (int i = 0; i < n; i++) {
+		auto x = (unsigned int)((polygons[i].xPos() - minX) * scale);
+		auto y = (unsigned int)((polygons[i].yPos() - minY) * scale);
+		keys[i] = { mortonCode(x, y), i };
+	}
+	std::sort(keys.begin(), keys.end());
+
+	auto newIndex = _frameArena.vector<int>();
+	newIndex.resize(n);
+	for (int i = 0; i < n; i++)
+		newIndex[keys[i].second] = i;
+
+	// Apply the permutation in place by following its cycles
+	auto destination = newIndex;
+	for (int i = 0; i < n; i++) {
+		while (destination[i] != i) {
+			int j = destination[i];
+			std::swap(polygons[i], polygons[j]);
+			std::swap(destination[i], destination[j]);
+		}
+	}
+
+	// Remap the indices the broadphase holds on to
+	for (auto& pair : _verletPairs) {
+		int a = newIndex[pair.first];
+		int b = newIndex[pair.second];
+		pair = { min(a, b), max(a, b) };
+	}
+	if (_verletPositions.size() == n)
+	{
+		auto positions = _frameArena.vector<Point<Real>>();
+		positions.resize(n);
+		for (int i = 0; i < n; i++)
+			positions[newIndex[i]] = _verletPositions[i];
+		std::copy(positions.begin(), positions.end(), _verletPositions.begin());
+	}
+
+	_framesSinceReorder = 0;
+	_reorders++;
+	_sortedSpacing = storageSpacing(polygons);
+}
+
+template class CollisionManager<float>;
+template class CollisionManager<double>;
+template class CollisionManager<double, float>;
\ No newline at end of file
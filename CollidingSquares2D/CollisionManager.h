@@ -1,37 +1,199 @@
 #pragma once
 
 #include <vector>
+#include <utility>
+#include <memory>
 #include "Polygon.h"
 #include "LinearAlgebra.h"
+#include "SpatialGrid.h"
+#include "GridHierarchy.h"
+#include "SpatialHash.h"
+#include "FrameArena.h"
+#include "SatKernels.h"
+#include "SimdKernels.h"
+#include "StaticGeometry.h"
+#include "ThreadPool.h"
 
-enum SAT_Method {
-	Detection,
-	WithOverlapRemoval
+enum Broadphase_Method {
+	UniformGrid,
+	VerletList,
+	LooseGrid,
+	HierarchicalGrid,
+	HashedGrid
 };
 
+template<typename Real>
 struct CollisionData {
-	LinearAlgebra::Point Point;
-	LinearAlgebra::Point Normal;
+	LinearAlgebra::Point<Real> Point;
+	LinearAlgebra::Point<Real> Normal;
 	bool NormalOnFirstArg;
 };
 
+// Real is the scalar of the bodies and the impulse response, Narrow the scalar the SAT kernels run in
+template<typename Real, typename Narrow = Real>
 class CollisionManager
 {
 public:
 	CollisionManager(int width2D, int height2D,
-		int collisionGridColumns = 3, int collisionGridRows = 3);
-	void wallCollisionHandling(Polygon& p) const;
-	void collisionCheckAndResolution(Polygon& a, Polygon& b) const;
-	void resolveCollisions(std::vector<Polygon>& polygons);
+		int collisionGridColumns = 0, int collisionGridRows = 0);	// 0 picks the grid from the bodies
+	void wallCollisionHandling(Polygon<Real>& p) const;
+	void staticCollisionHandling(Polygon<Real>& p) const;
+	void collisionCheckAndResolution(Polygon<Real>& a, Polygon<Real>& b) const;
+	void resolveCollisions(std::vector<Polygon<Real>>& polygons);
+	void resolveSubstepped(std::vector<Polygon<Real>>& polygons, Real dt, int substeps);	// Also integrates the bodies
+	void setBroadphase(Broadphase_Method method, double verletSkin = 10);
+	void setWalls(bool enabled);
+	bool walls() const;
+	void setPeriodic(bool x, bool y);	// Wrap-around axes, bodies leaving one side come back on the other
+	bool periodicX() const;
+	bool periodicY() const;
+	void wrapPosition(Polygon<Real>& p) const;	// Back into the world on periodic axes, after integration
+	void setStaticGeometry(const StaticGeometry<Real>& geometry);
+	const StaticGeometry<Real>& staticGeometry() const;
+	void setFastMath(bool enabled);
+	void setPositionCorrection(Real baumgarte, Real slop);
+	void setReorderInterval(int frames);	// Off by default, reorders the caller's vector so held indices go stale
+	int reorders() const;					// Times the bodies were reordered, a change means indices moved
+	void setThreads(int threads);
+	ThreadPool& threadPool();
+	const FrameArena& frameArena() const;
 private:
+	template<typename> friend class ContactBenchmark;
+	struct CellRange {
+		int firstColumn;
+		int lastColumn;
+		int firstRow;
+		int lastRow;
+	};
+	typedef unsigned long long PairKey;	// Corner counts in the top 16 bits, then two 24 bit body indices
+	static const int MaxBodies = 1 << 24;		// Past this body indices no longer fit a PairKey
+	struct Contact {					// Found by the narrowphase, resolved after all pairs are tested
+		int a;
+		int b;
+		LinearAlgebra::Point<Real> point;
+		LinearAlgebra::Point<Real> normal;	// From b towards a
+		Real depth;
+	};
+	struct ContactColours {				// No two contacts of one colour share a body
+		FrameVector<Contact> contacts;	// Sorted by colour, each colour padded to ContactLanes with a = -1
+		FrameVector<int> start;			// Offsets into contacts, one past the end per colour
+		bool overflow;					// Last colour holds the contacts that found no free colour
+	};
+	struct ContactRows {				// The coloured contacts again as separate arrays, for the wide velocity solver
+		FrameVector<int> a;				// Padding entries point at the spare body
+		FrameVector<int> b;
+		FrameVector<Real> normalX;
+		FrameVector<Real> normalY;
+		FrameVector<Real> aRxN;
+		FrameVector<Real> bRxN;
+		FrameVector<Real> normalMass;
+	};
+	struct BodyVelocities {				// Gathered from the bodies, with one spare body at the end
+		FrameVector<Real> x;
+		FrameVector<Real> y;
+		FrameVector<Real> angle;
+		FrameVector<Real> invMass;
+		FrameVector<Real> invInertia;
+	};
+	static const int ContactLanes = 8;	// Widest SIMD row of doubles
+	static const int NarrowphaseChunk = 256;	// Pairs per narrowphase task, fixed so the split never depends on the thread count
+	static const int MaxColours = 64;	// Contacts that find no free colour go to one extra colour solved in order
+
+	struct FrameBodies {				// Per body data gathered once per frame, as separate arrays
+		FrameVector<LinearAlgebra::Point<Narrow>> rotation;	// (cos, sin) of the angle
+		FrameVector<double> x;
+		FrameVector<double> y;
+		FrameVector<double> radius;
+		FrameVector<double> minX;
+		FrameVector<double> minY;
+		FrameVector<double> maxX;
+		FrameVector<double> maxY;
+		FrameVector<Simd::QuantizedBox> boxes;	// The box again in 8 bytes, for the first filter pass
+	};
+	struct CellLists {
+		FrameVector<CellRange> ranges;	// Cells covered by each body
+		FrameVector<int> start;			// Offsets into bodies, one past the end per cell
+		FrameVector<int> bodies;		// Bodies sorted by cell
+	};
+
 	int _width;
 	int _height;
 	int _columns;
 	int _rows;
-	std::vector<std::vector<Polygon*>> _collisionGrid;
-	bool sat_collided(Polygon& a, Polygon& b, SAT_Method handling = Detection) const;
-	bool rad_collided(Polygon& a, Polygon& b) const;
-	void removeOverlap(Polygon& a, Polygon& b) const;	//Obsolete, for circles only
-	void gridCollisions(std::vector<Polygon*>& polygons) const;
-	const CollisionData& collisionData(Polygon& a, Polygon& b) const;
+	bool _walls = true;
+	bool _periodicX = false;
+	bool _periodicY = false;
+	bool _fastMath = false;
+	Real _baumgarte = Real(0.8);		// Share of the penetration beyond the slop removed per step
+	Real _slop = Real(0.1);
+	double _columnWidth;
+	double _rowHeight;
+	bool _adaptiveGrid;
+	bool _gridFitted = false;
+	int _framesUntilGridFit = 0;
+	std::vector<double> _radii;
+	FrameArena _frameArena;
+	int _reorderInterval = 0;
+	int _framesSinceReorder = 0;
+	int _reorders = 0;
+	double _sortedSpacing = 0;		// Storage neighbour distance right after the last reorder
+	Broadphase_Method _broadphase = UniformGrid;
+	double _verletSkin = 10;
+	std::vector<std::pair<int, int>> _verletPairs;
+	std::vector<LinearAlgebra::Point<Real>> _verletPositions;	// Body positions when the list was built
+	SpatialGrid _looseGrid;
+	bool _looseGridFitted = false;
+	GridHierarchy _gridHierarchy;
+	SpatialHash _spatialHash;
+	StaticGeometry<Real> _staticGeometry;
+	std::unique_ptr<ThreadPool> _threadPool;
+	bool sat_collided(Polygon<Real>& a, Polygon<Real>& b, Real* depth = nullptr) const;
+	void staticCollision(Polygon<Real>& p, int shape) const;
+	bool rad_collided(Polygon<Real>& a, Polygon<Real>& b) const;
+	void removeOverlap(Polygon<Real>& a, Polygon<Real>& b) const;	//Obsolete, for circles only
+	Contact contact(Polygon<Real>& a, Polygon<Real>& b, int aIndex, int bIndex, Real depth) const;
+	void collisionResolution(Polygon<Real>& a, Polygon<Real>& b, const Contact& contact) const;
+	void correctPosition(Polygon<Real>& a, Polygon<Real>& b, const Contact& contact) const;
+	void uniformGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs);
+	bool firstSharedCell(const CellLists& lists, int a, int b, int cell) const;
+	static int firstSharedSpan(int aFirst, int aLast, int bFirst, int bLast, int count, bool periodic);
+	static int wrapCell(int index, int count);
+	CellRange cellRange(const Polygon<Real>& p, double margin) const;
+	void resizeCollisionGrid(int columns, int rows);
+	void fitCollisionGrid(const std::vector<Polygon<Real>>& polygons);
+	CellLists fillCollisionGrid(const std::vector<Polygon<Real>>& polygons, double margin);
+	bool verletListExpired(const std::vector<Polygon<Real>>& polygons) const;
+	void buildVerletList(const std::vector<Polygon<Real>>& polygons);
+	void expandedPairs(const std::vector<Polygon<Real>>& polygons, double reach, FrameVector<PairKey>& pairs);
+	void verletListPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs);
+	void looseGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs);
+	void hierarchicalGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs);
+	void hashedGridPairs(const std::vector<Polygon<Real>>& polygons, FrameVector<PairKey>& pairs);
+	static PairKey pairKey(const std::vector<Polygon<Real>>& polygons, int a, int b);
+	static int pairBodyA(PairKey pair);
+	static int pairBodyB(PairKey pair);
+	FrameBodies gatherBodies(std::vector<Polygon<Real>>& polygons);
+	void filterPairs(const FrameBodies& bodies, FrameVector<PairKey>& pairs) const;
+	void narrowphase(std::vector<Polygon<Real>>& polygons, FrameBodies& bodies, FrameVector<PairKey>& pairs);
+	void sortPairs(FrameVector<PairKey>& pairs);
+	ContactColours colourContacts(const FrameVector<Contact>& contacts, int bodies);
+	void solveContacts(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies, const ContactColours& colours);
+	void fillContactRows(const FrameBodies& bodies, const BodyVelocities& velocities, const ContactColours& colours, int first, int last, ContactRows& rows) const;
+	static void solveContactRows(const Simd::Kernels<Real>& kernels, const ContactColours& colours, const Simd::ContactRows<Real>& rows,
+		const Simd::BodyVelocities<Real>& velocities, int first, int last, Real restitution);
+	BodyVelocities gatherVelocities(const std::vector<Polygon<Real>>& polygons);
+	void narrowphaseBatch(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies, const FrameVector<PairKey>& pairs, int begin, int end, Contact* slots) const;
+	void wallCollisions(std::vector<Polygon<Real>>& polygons, const FrameBodies& bodies);
+	void projectBatch(std::vector<Polygon<Real>>& polygons, const FrameVector<LinearAlgebra::Point<Narrow>>& rotations, const FrameVector<PairKey>& pairs, int begin, int end, Real h);
+	void projectContact(Polygon<Real>& a, Polygon<Real>& b, Real depth, Real h) const;
+	CollisionData<Real> collisionData(Polygon<Real>& a, Polygon<Real>& b) const;
+	LinearAlgebra::Point<double> minimumImage(double dx, double dy) const;
+	LinearAlgebra::Point<Real> imageShift(const Polygon<Real>& a, const Polygon<Real>& b) const;
+	static void shiftBody(Polygon<Real>& p, LinearAlgebra::Point<Real> shift);
+	static void restoreBody(Polygon<Real>& p, LinearAlgebra::Point<Real> before, LinearAlgebra::Point<Real> shift);
+	void splitSeamPairs(const std::vector<Polygon<Real>>& polygons, double reach, FrameVector<PairKey>& pairs, FrameVector<PairKey>& seam);
+	void seamCollisions(std::vector<Polygon<Real>>& polygons, FrameBodies& bodies, const FrameVector<PairKey>& seam) const;
+	double storageSpacing(const std::vector<Polygon<Real>>& polygons) const;
+	bool bodyOrderDegraded(const std::vector<Polygon<Real>>& polygons);
+	void sortBodies(std::vector<Polygon<Real>>& polygons);
 };
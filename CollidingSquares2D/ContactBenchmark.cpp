@@ -0,0 +1,187 @@
+#define _USE_MATH_DEFINES
+#include "ContactBenchmark.h"
+
+#ifdef CONTACT_BENCHMARK
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "CollisionManager.h"
+#include "SimdKernels.h"
+using namespace LinearAlgebra;
+
+template<typename Work>
+static double microseconds(Work work)
+{
+	auto start = std::chrono::steady_clock::now();
+	work();
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Real>
+static bool loadTier(Simd::Tier tier, Simd::Kernels<Real>& kernels)
+{
+	switch (tier)
+	{
+	case Simd::Scalar:
+		Simd::loadScalar(kernels);
+		return true;
+#if defined(SIMD_X86)
+	case Simd::SSE2:
+		Simd::loadSse2(kernels);
+		return true;
+	case Simd::AVX2:
+		Simd::loadAvx2(kernels);
+		return true;
+	case Simd::AVX512:
+		Simd::loadAvx512(kernels);
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+template<typename Real>
+void ContactBenchmark<Real>::run(int bodies, int contacts, int repetitions, std::ostream& out, int crowded)
+{	// Bodies on a grid with random velocities, contacts between random pairs with random normals. Both paths
+	// start every repetition from the same velocities, and the tiers are compared with the scalar result at the end.
+	typedef CollisionManager<Real> Manager;
+	const int size = 4000;
+	Manager manager(size, size);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> unit(0, 1);
+
+	std::vector<Polygon<Real>> polygons;
+	int columns = (int)ceil(sqrt(double(bodies)));
+	for (int i = 0; i < bodies; i++) {
+		Polygon<Real> p(Real(6 + 6 * unit(random)), 3 + random() % 4);
+		p.setPosition(Real(size * (i % columns + 0.5) / columns), Real(size * (i / columns + 0.5) / columns));
+		p.setVelocity(Real(200 * unit(random) - 100), Real(200 * unit(random) - 100), 0);
+		p.updatePosition(0);
+		polygons.push_back(p);
+	}
+
+	auto list = manager._frameArena.template vector<typename Manager::Contact>();
+	for (int i = 0; i < crowded + contacts; i++) {
+		int a = i < crowded ? 0 : random() % bodies;
+		int b = random() % bodies;
+		if (a == b)
+			continue;
+		double angle = 2 * M_PI * unit(random);
+		Point<Real> normal = { Real(cos(angle)), Real(sin(angle)) };
+		Point<Real> point = { (polygons[a].xPos() + polygons[b].xPos()) / 2, (polygons[a].yPos() + polygons[b].yPos()) / 2 };
+		list.push_back({ a, b, point, normal, Real(0.5) });
+	}
+	auto colours = manager.colourContacts(list, bodies);
+	int count = colours.contacts.size();
+	out << (sizeof(Real) == 8 ? "double" : "float") << ": " << bodies << " bodies, " << list.size() << " contacts in "
+		<< colours.start.size() - 1 << (colours.overflow ? " colours, the last one overflowing\n" : " colours\n");
+
+	std::vector<Point<Real>> startVelocity(bodies);
+	std::vector<Real> startSpin(bodies);
+	for (int i = 0; i < bodies; i++) {
+		startVelocity[i] = { polygons[i].xVelocity(), polygons[i].yVelocity() };
+		startSpin[i] = polygons[i].angleVelocity();
+	}
+	auto restart = [&] {
+		for (int i = 0; i < bodies; i++)
+			polygons[i].setVelocity(startVelocity[i].x, startVelocity[i].y, startSpin[i]);
+	};
+
+	double scalar = 0;
+	for (int r = 0; r < repetitions; r++) {
+		restart();
+		scalar += microseconds([&] {
+			for (auto& contact : colours.contacts) {
+				if (contact.a >= 0)
+					manager.collisionResolution(polygons[contact.a], polygons[contact.b], contact);
+			}
+		});
+	}
+	scalar /= repetitions;
+	std::vector<Real> expected(bodies);
+	for (int i = 0; i < bodies; i++)
+		expected[i] = polygons[i].xVelocity();
+	out << "  collisionResolution  " << scalar << " us\n";
+
+	restart();
+	auto frame = manager.gatherBodies(polygons);
+	auto velocities = manager.gatherVelocities(polygons);
+	typename Manager::ContactRows rows = { manager._frameArena.template vector<int>(), manager._frameArena.template vector<int>(),
+		manager._frameArena.template vector<Real>(), manager._frameArena.template vector<Real>(), manager._frameArena.template vector<Real>(),
+		manager._frameArena.template vector<Real>(), manager._frameArena.template vector<Real>() };
+	rows.a.resize(count);
+	rows.b.resize(count);
+	rows.normalX.resize(count);
+	rows.normalY.resize(count);
+	rows.aRxN.resize(count);
+	rows.bRxN.resize(count);
+	rows.normalMass.resize(count);
+	Simd::ContactRows<Real> rowArrays = { rows.a.data(), rows.b.data(), rows.normalX.data(), rows.normalY.data(),
+		rows.aRxN.data(), rows.bRxN.data(), rows.normalMass.data() };
+	Simd::BodyVelocities<Real> velocityArrays = { velocities.x.data(), velocities.y.data(), velocities.angle.data(),
+		velocities.invMass.data(), velocities.invInertia.data() };
+
+	std::vector<Real> scalarTier;	// Velocities after the scalar tier's pass, the wider tiers must match them bit for bit
+	for (int tier = Simd::Scalar; tier <= Simd::detectedTier(); tier++) {
+		Simd::Kernels<Real> kernels;
+		if (!loadTier((Simd::Tier)tier, kernels))
+			continue;
+
+		// Kernel alone on rows filled once, then the whole pass as resolveCollisions runs it
+		double kernel = 0;
+		double pass = 0;
+		for (int r = 0; r < repetitions; r++) {
+			restart();
+			for (int i = 0; i < bodies; i++) {
+				velocities.x[i] = startVelocity[i].x;
+				velocities.y[i] = startVelocity[i].y;
+				velocities.angle[i] = startSpin[i];
+			}
+			manager.fillContactRows(frame, velocities, colours, 0, count, rows);
+			kernel += microseconds([&] {
+				for (int c = 0; c + 1 < colours.start.size(); c++)
+					Manager::solveContactRows(kernels, colours, rowArrays, velocityArrays, colours.start[c], colours.start[c + 1], Real(1));
+			});
+
+			restart();
+			pass += microseconds([&] {
+				for (int i = 0; i < bodies; i++) {
+					velocities.x[i] = polygons[i].xVelocity();
+					velocities.y[i] = polygons[i].yVelocity();
+					velocities.angle[i] = polygons[i].angleVelocity();
+				}
+				for (int c = 0; c + 1 < colours.start.size(); c++) {
+					manager.fillContactRows(frame, velocities, colours, colours.start[c], colours.start[c + 1], rows);
+					Manager::solveContactRows(kernels, colours, rowArrays, velocityArrays, colours.start[c], colours.start[c + 1], Real(1));
+				}
+				for (int i = 0; i < bodies; i++)
+					polygons[i].setVelocity(velocities.x[i], velocities.y[i], velocities.angle[i]);
+			});
+		}
+		kernel /= repetitions;
+		pass /= repetitions;
+
+		double difference = 0;
+		int mismatches = 0;
+		for (int i = 0; i < bodies; i++) {
+			difference = std::max(difference, double(fabs(polygons[i].xVelocity() - expected[i]) / (1 + fabs(expected[i]))));
+			Real velocity[] = { polygons[i].xVelocity(), polygons[i].yVelocity(), polygons[i].angleVelocity() };
+			for (int k = 0; k < 3; k++) {
+				if (tier == Simd::Scalar)
+					scalarTier.push_back(velocity[k]);
+				else if (velocity[k] != scalarTier[3 * i + k])
+					mismatches++;
+			}
+		}
+		out << "  " << Simd::tierName((Simd::Tier)tier) << " kernel " << kernel << " us (" << scalar / kernel << "x), with gather, rows and scatter "
+			<< pass << " us (" << scalar / pass << "x), largest relative difference " << difference << ", "
+			<< mismatches << " velocities differ from the scalar tier\n";
+	}
+}
+
+template class ContactBenchmark<float>;
+template class ContactBenchmark<double>;
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <ostream>
+
+// Times the contact velocity pass on random coloured contacts: collisionResolution one contact at a time against
+// each SIMD tier's solveContactRows, the kernel alone and with the gather, row fill and scatter around it.
+// crowded contacts all touch body 0, more than CollisionManager::MaxColours of them force the overflow colour.
+// Compiled in with CONTACT_BENCHMARK, which also makes main run it instead of opening the window.
+template<typename Real>
+class ContactBenchmark
+{
+public:
+	static void run(int bodies, int contacts, int repetitions, std::ostream& out, int crowded = 0);
+};
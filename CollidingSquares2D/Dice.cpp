@@ -19,8 +19,9 @@ int Roll::from_to_(int min, int max)
 
 double Roll::fraction()
 {
-    static std::mt19937 gen{ std::random_device{}() };
-    static std::uniform_int_distribution<> distrib(0, 99);
+    // One generator per thread, polygons roll their colour and may be built on several threads
+    static thread_local std::mt19937 gen{ std::random_device{}() };
+    static thread_local std::uniform_int_distribution<> distrib(0, 99);
     return 0.01 * distrib(gen);
 }
 
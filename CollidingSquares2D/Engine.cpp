@@ -3,7 +3,7 @@
 
 // Constructor
 Engine::Engine(int windowWidth, int windowHeight, int polygonColumns, int polygonRows)
-    : _collisionManager(windowWidth, windowHeight)
+    : _world(windowWidth, windowHeight)
 {
     initializeWindow(windowWidth, windowHeight);
     initializePolygons(polygonColumns, polygonRows);
@@ -48,7 +48,9 @@ void Engine::update()
 void Engine::render()
 {
     _window->clear(sf::Color(140, 166, 181));
+    renderStaticGeometry();
     renderPolygons();
+    renderParticles();
 }
 
 void Engine::display()
@@ -73,30 +75,58 @@ void Engine::initializePolygons(int columns, int rows)
     double k = _videoMode.width * 0.01;
     for (int i = 0; i < columns; i++) {
         for (int j = 0; j < rows; j++) {
-            auto p = Polygon(k * Roll::from_to_(5, 8), Roll::from_to_(3, 6));
+            auto p = Polygon<float>(k * Roll::from_to_(5, 8), Roll::from_to_(3, 6));
             auto xPos = _videoMode.width * (i + 1.0) / (columns + 1.0);
             auto yPos = _videoMode.height * (j + 1.0) / (rows + 1.0);
             p.setPosition(xPos, yPos);
             p.setVelocity(k * Roll::from_to_(-10, 10), k * Roll::from_to_(-10, 10), 0);
-            _polygons.push_back(p);
+            _world.addBody(p);
         }
     }
 }
 
 void Engine::updatePolygons()
 {
-    _collisionManager.resolveCollisions(_polygons);
-
-    for (auto& polygon : _polygons) {
-        _collisionManager.wallCollisionHandling(polygon);
-        polygon.updatePosition(_dt);
-    }
+    _world.step(_dt);
 }
 
 void Engine::renderPolygons()
 {
-    for (auto& polygon : _polygons) {
+    for (auto& polygon : _world.bodies()) {
         _window->draw(polygon.shape());
     }    
 }
 
+void Engine::renderParticles()
+{
+    auto& particles = _world.particles();
+    if (particles.size() == 0)
+        return;
+
+    // One point per particle in a single draw call, grains are too small and too many for a shape each
+    sf::VertexArray points(sf::Points, particles.size());
+    for (int i = 0; i < particles.size(); i++)
+        points[i].position = sf::Vector2f(particles.xPositions()[i], particles.yPositions()[i]);
+    _window->draw(points);
+}
+
+void Engine::renderStaticGeometry()
+{
+    auto& geometry = _world.collisionManager().staticGeometry();
+    for (int i = 0; i < geometry.shapes(); i++) {
+        auto corners = geometry.shapeCorners(i);
+        if (geometry.shapeSize(i) == 2)
+        {
+            sf::Vertex line[] = { sf::Vector2f(corners[0].x, corners[0].y), sf::Vector2f(corners[1].x, corners[1].y) };
+            _window->draw(line, 2, sf::Lines);
+            continue;
+        }
+
+        sf::ConvexShape shape(geometry.shapeSize(i));
+        for (int j = 0; j < geometry.shapeSize(i); j++)
+            shape.setPoint(j, sf::Vector2f(corners[j].x, corners[j].y));
+        shape.setFillColor(sf::Color(90, 100, 110));
+        _window->draw(shape);
+    }
+}
+
@@ -2,8 +2,7 @@
 
 #include <SFML/Graphics.hpp>
 #include <vector>
-#include "Polygon.h"
-#include "CollisionManager.h"
+#include "World.h"
 
 class Engine
 {
@@ -25,8 +24,7 @@ private:
 	std::unique_ptr<sf::RenderWindow> _window;
 	sf::VideoMode _videoMode;
 	sf::Event _event;
-	std::vector<Polygon> _polygons;
-	CollisionManager _collisionManager;
+	World<float> _world;
 	sf::Clock _clock;
 	float _dt;
 
@@ -35,4 +33,6 @@ private:
 	void initializePolygons(int columns, int rows);
 	void updatePolygons();
 	void renderPolygons();
+	void renderParticles();
+	void renderStaticGeometry();
 };
\ No newline at end of file
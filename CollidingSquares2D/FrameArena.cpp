@@ -0,0 +1,211 @@
+#include "FrameArena.h"
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+static std::atomic<std::size_t> heapAllocationCount(0);
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// Debug aid: count every allocation so a test can check that steady-state steps make none.
+// All replaceable forms are covered, a plain, array, nothrow or aligned new that slipped past would hide an allocation.
+static void* countedAllocate(std::size_t size)
+{
+	heapAllocationCount++;
+	return malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = countedAllocate(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+#ifdef __cpp_aligned_new
+// Over-aligned types go through these from C++17 on, MSVC needs its own aligned free
+static void* countedAllocate(std::size_t size, std::align_val_t alignment)
+{
+	heapAllocationCount++;
+	std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, align);
+#else
+	void* p = nullptr;
+	return posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+static void alignedFree(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void* p = countedAllocate(size, alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	alignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	alignedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	alignedFree(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	alignedFree(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	alignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	alignedFree(p);
+}
+#endif
+#endif
+
+FrameArena::FrameArena(std::size_t blockSize)
+{
+	_blockSize = blockSize;
+	addBlock(_blockSize);
+}
+
+std::size_t FrameArena::bytesUsed() const
+{
+	return _used;
+}
+
+std::size_t FrameArena::blockAllocations() const
+{
+	return _blockAllocations;
+}
+
+std::size_t FrameArena::heapAllocations()
+{
+	return heapAllocationCount;
+}
+
+void FrameArena::reset()
+{	// A step that spilled over several blocks gets one block big enough for all of it next time
+	if (_blocks.size() > 1)
+	{
+		std::size_t total = 0;
+		for (auto& block : _blocks)
+			total += block.size;
+		_blocks.clear();
+		addBlock(total);
+	}
+	_current = 0;
+	_offset = 0;
+	_used = 0;
+}
+
+void* FrameArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+	_used += bytes;
+
+	while (true) {
+		auto& block = _blocks[_current];
+		auto base = reinterpret_cast<std::uintptr_t>(block.data.get());
+		std::size_t start = ((base + _offset + alignment - 1) & ~(alignment - 1)) - base;
+		if (start + bytes <= block.size)
+		{
+			_offset = start + bytes;
+			return block.data.get() + start;
+		}
+
+		if (_current + 1 == _blocks.size())
+			addBlock(bytes + alignment > _blockSize ? bytes + alignment : _blockSize);
+		_current++;
+		_offset = 0;
+	}
+}
+
+void FrameArena::addBlock(std::size_t size)
+{
+	_blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+	_blockAllocations++;
+}
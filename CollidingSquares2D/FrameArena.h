@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+template<typename T> struct ArenaAllocator;
+template<typename T> using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+class FrameArena
+{	// Bump allocator for data that only lives for one step, reset at the start of every step
+public:
+	//Constructor
+	FrameArena(std::size_t blockSize = 64 * 1024);
+	//Accessors
+	std::size_t bytesUsed() const;
+	std::size_t blockAllocations() const;	// Stops growing once the step size has settled
+	static std::size_t heapAllocations();	// Every operator new in the process, needs COUNT_HEAP_ALLOCATIONS
+	//Functions
+	void reset();
+	void* allocate(std::size_t bytes, std::size_t alignment);
+	template<typename T> FrameVector<T> vector();
+private:
+	struct Block {
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	//Variables
+	std::size_t _blockSize;
+	std::size_t _blockAllocations = 0;
+	std::vector<Block> _blocks;
+	std::size_t _current = 0;	// Block being bumped
+	std::size_t _offset = 0;
+	std::size_t _used = 0;		// Bytes handed out since the last reset
+	//Private functions
+	void addBlock(std::size_t size);
+};
+
+template<typename T>
+struct ArenaAllocator
+{	// Lets standard containers live in a FrameArena, memory is only reclaimed by FrameArena::reset
+	using value_type = T;
+
+	FrameArena* arena;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+	template<typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T*, std::size_t) {}
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return !(a == b);
+}
+
+template<typename T>
+FrameVector<T> FrameArena::vector()
+{
+	return FrameVector<T>(ArenaAllocator<T>(*this));
+}
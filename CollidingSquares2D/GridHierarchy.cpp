@@ -0,0 +1,84 @@
+#include "GridHierarchy.h"
+#include <algorithm>
+#include <limits>
+
+GridHierarchy::GridHierarchy(double width, double height)
+{
+	resize(width, height);
+}
+
+int GridHierarchy::levels() const
+{
+	return _levels.size();
+}
+
+void GridHierarchy::resize(double width, double height)
+{
+	_width = width;
+	_height = height;
+	_baseCellSize = 0;
+	_levels.clear();
+}
+
+template<typename Real>
+void GridHierarchy::build(const std::vector<Polygon<Real>>& polygons)
+{
+	if (polygons.empty())
+		return;
+
+	double minRadius = std::numeric_limits<double>::max();
+	double maxRadius = 0;
+	for (auto& polygon : polygons) {
+		minRadius = std::min(minRadius, double(polygon.vertexRadius()));
+		maxRadius = std::max(maxRadius, double(polygon.vertexRadius()));
+	}
+
+	// Relayout only when the smallest bodies no longer match level 0 or the largest outgrow the top level
+	double baseCellSize = std::max(2 * minRadius, 1.0);
+	bool baseMismatch = baseCellSize < 0.5 * _baseCellSize || baseCellSize > 2 * _baseCellSize;
+	bool topTooSmall = _levels.empty() || _levels.back().cellSize() < 2 * maxRadius;
+	if (baseMismatch || topTooSmall)
+		layoutLevels(baseMismatch ? baseCellSize : _baseCellSize, 2 * maxRadius);
+
+	for (auto& level : _levels)
+		level.clear();
+	std::fill(_levelSize.begin(), _levelSize.end(), 0);
+
+	_levelOfBody.resize(polygons.size());
+	_centers.resize(polygons.size());
+	for (int i = 0; i < polygons.size(); i++) {
+		int level = levelFor(2 * polygons[i].vertexRadius());
+		_levelOfBody[i] = level;
+		_levelSize[level]++;
+		_centers[i] = { polygons[i].xPos(), polygons[i].yPos() };
+		_levels[level].insert(i, _centers[i].x, _centers[i].y);
+	}
+
+	for (auto& level : _levels)
+		level.finalize();
+}
+
+void GridHierarchy::layoutLevels(double baseCellSize, double maxDiameter)
+{
+	_baseCellSize = baseCellSize;
+	_levels.clear();
+
+	double cellSize = baseCellSize;
+	_levels.emplace_back(_width, _height, cellSize);
+	while (cellSize < maxDiameter) {
+		cellSize *= 2;
+		_levels.emplace_back(_width, _height, cellSize);
+	}
+	_levelSize.assign(_levels.size(), 0);
+}
+
+int GridHierarchy::levelFor(double diameter) const
+{	// Smallest level whose cells can hold the body
+	int level = 0;
+	while (level + 1 < _levels.size() && _levels[level].cellSize() < diameter)
+		level++;
+	return level;
+}
+
+template void GridHierarchy::build(const std::vector<Polygon<float>>& polygons);
+template void GridHierarchy::build(const std::vector<Polygon<double>>& polygons);
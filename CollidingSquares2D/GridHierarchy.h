@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "Polygon.h"
+#include "LinearAlgebra.h"
+#include "SpatialGrid.h"
+
+class GridHierarchy
+{	// Loose grids whose cell sizes double per level, each body lives in the level matching its size
+public:
+	//Constructor
+	GridHierarchy(double width = 1, double height = 1);
+	//Accessors
+	int levels() const;
+	//Functions
+	void resize(double width, double height);
+	template<typename Real> void build(const std::vector<Polygon<Real>>& polygons);
+	template<typename Visit> void forEachPair(Visit&& visit) const;
+private:
+	//Variables
+	double _width;
+	double _height;
+	double _baseCellSize = 0;
+	std::vector<SpatialGrid> _levels;
+	std::vector<int> _levelSize;
+	std::vector<int> _levelOfBody;
+	std::vector<LinearAlgebra::Point<double>> _centers;
+	//Private functions
+	void layoutLevels(double baseCellSize, double maxDiameter);
+	int levelFor(double diameter) const;
+};
+
+template<typename Visit>
+void GridHierarchy::forEachPair(Visit&& visit) const
+{
+	// Pairs within a level
+	for (int level = 0; level < _levels.size(); level++) {
+		if (_levelSize[level] > 1)
+			_levels[level].forEachPair(visit);
+	}
+
+	// Pairs across levels, found by the smaller body looking around its center in every coarser level
+	for (int body = 0; body < _levelOfBody.size(); body++) {
+		for (int level = _levelOfBody[body] + 1; level < _levels.size(); level++) {
+			if (_levelSize[level] == 0)
+				continue;
+
+			_levels[level].forEachNear(_centers[body].x, _centers[body].y, [&](int other) {
+				visit(body, other);
+			});
+		}
+	}
+}
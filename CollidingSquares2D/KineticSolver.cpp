@@ -0,0 +1,423 @@
+#include "KineticSolver.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <limits>
+using namespace LinearAlgebra;
+using std::min;
+using std::max;
+
+// Close pairs and bodies near walls are looked at again once they could have closed their gap plus this much,
+// so contacts are found slightly inside and the looks never crowd together
+static const double Overshoot = 0.05;
+static const double Never = std::numeric_limits<double>::infinity();
+
+template<typename Real, typename Narrow>
+bool KineticSolver<Real, Narrow>::Event::operator>(const Event& e) const
+{	// Ties broken on the bodies, so the order never depends on how the queue was filled
+	if (time != e.time)
+		return time > e.time;
+	if (body != e.body)
+		return body > e.body;
+	if (other != e.other)
+		return other > e.other;
+	return kind > e.kind;
+}
+
+template<typename Real, typename Narrow>
+KineticSolver<Real, Narrow>::KineticSolver(int width, int height)
+{
+	_width = width;
+	_height = height;
+}
+
+template<typename Real, typename Narrow>
+int KineticSolver<Real, Narrow>::eventsLastStep() const
+{
+	return _eventsLastStep;
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::invalidate()
+{
+	_valid = false;
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::step(std::vector<Polygon<Real>>& polygons, CollisionManager<Real, Narrow>& collisions, Real dt)
+{	// Events up to the end of the step in time order, then every body drifts to the end.
+	// A burst of events past the cap leaves the rest to a rebuild on the next step.
+	if (!_valid || changedOutside(polygons))
+		rebuild(polygons, collisions);
+
+	double end = _time + dt;
+	long long cap = 64 * (long long)polygons.size() + 1024;
+	_eventsLastStep = 0;
+	while (!_events.empty() && _events.front().time <= end) {
+		Event e = _events.front();
+		std::pop_heap(_events.begin(), _events.end(), std::greater<Event>());
+		_events.pop_back();
+		if (stale(e))
+			continue;
+		if (++_eventsLastStep > cap) {
+			_valid = false;
+			break;
+		}
+		_time = max(_time, e.time);
+
+		auto& p = polygons[e.body];
+		switch (e.kind)
+		{
+		case CellEvent:
+		{	// Only the cells that just came within reach can hold new partners
+			int columns = _grid.columns();
+			int oldRow = _cell[e.body] / columns;
+			int oldColumn = _cell[e.body] % columns;
+			moveToCell(e.body, e.other);
+			int row = e.other / columns;
+			int column = e.other % columns;
+			for (int i = max(0, row - 1); i <= min(_grid.rows() - 1, row + 1); i++) {
+				for (int j = max(0, column - 1); j <= min(columns - 1, column + 1); j++) {
+					if (abs(i - oldRow) <= 1 && abs(j - oldColumn) <= 1)
+						continue;
+					for (int other = _cellHead[i * columns + j]; other >= 0; other = _next[other])
+						predictPair(polygons, e.body, other);
+				}
+			}
+			predictCell(polygons, e.body);
+			break;
+		}
+		case WallEvent:
+		{
+			advance(p, e.body, _time);
+			auto before = state(p);
+			collisions.wallCollisionHandling(p);
+			p.updatePosition(0);
+			if (sameState(before, state(p)))
+				predictWall(polygons, collisions, e.body);
+			else {
+				_counts[e.body]++;
+				predictBody(polygons, collisions, e.body, -1);
+			}
+			break;
+		}
+		case PairEvent:
+		{	// Nothing changed means only this pair needs another look, every other prediction still holds
+			auto& q = polygons[e.other];
+			advance(p, e.body, _time);
+			advance(q, e.other, _time);
+			auto beforeP = state(p);
+			auto beforeQ = state(q);
+			collisions.collisionCheckAndResolution(p, q);
+			p.updatePosition(0);
+			q.updatePosition(0);
+			if (sameState(beforeP, state(p)) && sameState(beforeQ, state(q)))
+				predictPair(polygons, e.body, e.other);
+			else {
+				_counts[e.body]++;
+				_counts[e.other]++;
+				predictBody(polygons, collisions, e.body, e.other);
+				predictBody(polygons, collisions, e.other, -1);
+			}
+			break;
+		}
+		}
+	}
+
+	_time = end;
+	_lastState.resize(polygons.size());
+	for (int i = 0; i < polygons.size(); i++) {
+		advance(polygons[i], i, end);
+		_lastState[i] = state(polygons[i]);
+	}
+}
+
+template<typename Real, typename Narrow>
+bool KineticSolver<Real, Narrow>::changedOutside(const std::vector<Polygon<Real>>& polygons) const
+{	// Bodies added, removed or pushed between steps make every prediction suspect
+	if (polygons.size() != _lastState.size())
+		return true;
+	for (int i = 0; i < polygons.size(); i++) {
+		if (!sameState(_lastState[i], state(polygons[i])))
+			return true;
+	}
+	return false;
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::rebuild(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions)
+{	// Cells at least as wide as the widest pair of touching circles, or about one body per cell when that is wider
+	int count = polygons.size();
+	double maxRadius = 0;
+	for (auto& p : polygons)
+		maxRadius = max(maxRadius, double(p.vertexRadius()));
+	_grid.resize(_width, _height, max(2.1 * maxRadius, sqrt(double(_width) * _height / max(count, 1))));
+
+	_cellHead.assign(_grid.columns() * _grid.rows(), -1);
+	_next.assign(count, -1);
+	_prev.assign(count, -1);
+	_cell.assign(count, -1);
+	_bodyTime.assign(count, _time);
+	_counts.assign(count, 0);
+	_events.clear();
+	for (int i = 0; i < count; i++)
+		moveToCell(i, _grid.cellOf(polygons[i].xPos(), polygons[i].yPos()));
+
+	int columns = _grid.columns();
+	for (int body = 0; body < count; body++) {
+		int row = _cell[body] / columns;
+		int column = _cell[body] % columns;
+		for (int i = max(0, row - 1); i <= min(_grid.rows() - 1, row + 1); i++) {
+			for (int j = max(0, column - 1); j <= min(columns - 1, column + 1); j++) {
+				for (int other = _cellHead[i * columns + j]; other >= 0; other = _next[other]) {
+					if (other > body)
+						predictPair(polygons, body, other);
+				}
+			}
+		}
+		predictWall(polygons, collisions, body);
+		predictCell(polygons, body);
+	}
+	_valid = true;
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::advance(Polygon<Real>& p, int body, double time)
+{
+	if (time <= _bodyTime[body])
+		return;
+	p.updatePosition(Real(time - _bodyTime[body]));
+	_bodyTime[body] = time;
+}
+
+template<typename Real, typename Narrow>
+Point<double> KineticSolver<Real, Narrow>::positionAt(const Polygon<Real>& p, int body, double time) const
+{	// Without moving the body, corners are only worth updating for bodies that take part in an event
+	double elapsed = time - _bodyTime[body];
+	return { p.xPos() + p.xVelocity() * elapsed, p.yPos() + p.yVelocity() * elapsed };
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::predictBody(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions, int body, int skip)
+{	// Everything about a body whose motion just changed, skip is a partner predicted from its own side
+	int columns = _grid.columns();
+	int row = _cell[body] / columns;
+	int column = _cell[body] % columns;
+	for (int i = max(0, row - 1); i <= min(_grid.rows() - 1, row + 1); i++) {
+		for (int j = max(0, column - 1); j <= min(columns - 1, column + 1); j++) {
+			for (int other = _cellHead[i * columns + j]; other >= 0; other = _next[other]) {
+				if (other != body && other != skip)
+					predictPair(polygons, body, other);
+			}
+		}
+	}
+	predictWall(polygons, collisions, body);
+	predictCell(polygons, body);
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::predictPair(std::vector<Polygon<Real>>& polygons, int a, int b)
+{	// Apart: when the bounding circles first touch. Circles touching: the shapes are looked at again
+	// once every point could have closed the gap between them, a lower bound on the time to contact.
+	auto& pa = polygons[a];
+	auto& pb = polygons[b];
+	auto positionA = positionAt(pa, a, _time);
+	auto positionB = positionAt(pb, b, _time);
+	double dx = positionA.x - positionB.x;
+	double dy = positionA.y - positionB.y;
+	double vx = double(pa.xVelocity()) - pb.xVelocity();
+	double vy = double(pa.yVelocity()) - pb.yVelocity();
+	double rSum = double(pa.vertexRadius()) + pb.vertexRadius();
+	double distanceSquared = dx * dx + dy * dy;
+
+	if (distanceSquared >= (rSum + Overshoot) * (rSum + Overshoot)) {
+		double closing = dx * vx + dy * vy;
+		double speedSquared = vx * vx + vy * vy;
+		if (closing >= 0 || speedSquared == 0)
+			return;
+		double discriminant = closing * closing - speedSquared * (distanceSquared - rSum * rSum);
+		if (discriminant < 0)
+			return;
+		push(PairEvent, _time + (-closing - sqrt(discriminant)) / speedSquared, a, b);
+		return;
+	}
+
+	// Along a fixed axis the gap only closes as fast as the bodies approach along it plus their spin
+	double spin = abs(double(pa.angleVelocity())) * pa.vertexRadius() + abs(double(pb.angleVelocity())) * pb.vertexRadius();
+	advance(pa, a, _time);
+	advance(pb, b, _time);
+	Point<double> axis;
+	double gap = separation(pa, pb, axis);
+	if (gap < 0) {
+		// Still overlapping after a collision, looked at again about when they could have come apart
+		double bound = sqrt(vx * vx + vy * vy) + spin;
+		if (bound > 0)
+			push(PairEvent, _time + (Overshoot - gap) / bound, a, b);
+		return;
+	}
+	double bound = max(0.0, vx * axis.x + vy * axis.y) + spin;
+	if (bound > 0)
+		push(PairEvent, _time + (gap + Overshoot) / bound, a, b);
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::predictWall(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions, int body)
+{	// Same split as for pairs per wall, the bounding circle until it reaches the wall, then the corners
+	if (!collisions.walls())
+		return;
+
+	auto& p = polygons[body];
+	auto position = positionAt(p, body, _time);
+	double r = p.vertexRadius();
+	double vx = p.xVelocity();
+	double vy = p.yVelocity();
+	double spin = abs(double(p.angleVelocity())) * r;
+	Point<double> low = { Never, Never };
+	Point<double> high = { -Never, -Never };
+	double reach = r + Overshoot;
+	if (position.x < reach || position.x > _width - reach || position.y < reach || position.y > _height - reach) {
+		advance(p, body, _time);
+		for (auto& corner : p.vertices()) {
+			low = { min(low.x, double(corner.x)), min(low.y, double(corner.y)) };
+			high = { max(high.x, double(corner.x)), max(high.y, double(corner.y)) };
+		}
+	}
+
+	// A corner already in the wall counts as touching it, the next look comes after it could have gone Overshoot deeper
+	double s = Never;
+	auto wall = [&](double centerGap, double towards, double cornerGap) {
+		double speed = max(0.0, towards) + spin;
+		if (centerGap >= reach) {
+			if (towards > 0)
+				s = min(s, (centerGap - r) / towards);
+		}
+		else if (speed > 0)
+			s = min(s, (max(cornerGap, 0.0) + Overshoot) / speed);
+	};
+	wall(position.x, -vx, low.x);
+	wall(_width - position.x, vx, _width - high.x);
+	wall(position.y, -vy, low.y);
+	wall(_height - position.y, vy, _height - high.y);
+	if (s < Never)
+		push(WallEvent, _time + s, body, -1);
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::predictCell(const std::vector<Polygon<Real>>& polygons, int body)
+{	// First cell border the center reaches, border cells reach out past the world on their open side
+	auto& p = polygons[body];
+	auto position = positionAt(p, body, _time);
+	double vx = p.xVelocity();
+	double vy = p.yVelocity();
+	double size = _grid.cellSize();
+	int columns = _grid.columns();
+	int cell = _cell[body];
+	int row = cell / columns;
+	int column = cell % columns;
+
+	double s = Never;
+	int target = -1;
+	auto consider = [&](double time, int next) {
+		if (time < s) {
+			s = time;
+			target = next;
+		}
+	};
+	if (vx > 0 && column + 1 < columns)
+		consider(((column + 1) * size - position.x) / vx, cell + 1);
+	if (vx < 0 && column > 0)
+		consider((column * size - position.x) / vx, cell - 1);
+	if (vy > 0 && row + 1 < _grid.rows())
+		consider(((row + 1) * size - position.y) / vy, cell + columns);
+	if (vy < 0 && row > 0)
+		consider((row * size - position.y) / vy, cell - columns);
+	if (target >= 0)
+		push(CellEvent, _time + max(s, 0.0), body, target);
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::moveToCell(int body, int cell)
+{
+	if (_cell[body] >= 0) {
+		if (_prev[body] >= 0)
+			_next[_prev[body]] = _next[body];
+		else
+			_cellHead[_cell[body]] = _next[body];
+		if (_next[body] >= 0)
+			_prev[_next[body]] = _prev[body];
+	}
+	_cell[body] = cell;
+	_prev[body] = -1;
+	_next[body] = _cellHead[cell];
+	if (_next[body] >= 0)
+		_prev[_next[body]] = body;
+	_cellHead[cell] = body;
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::push(Event_Kind kind, double time, int body, int other)
+{
+	if (_events.size() == _events.capacity())
+		dropStaleEvents();
+	unsigned int otherCount = kind == PairEvent ? _counts[other] : 0;
+	_events.push_back({ time, body, other, kind, _counts[body], otherCount });
+	std::push_heap(_events.begin(), _events.end(), std::greater<Event>());
+}
+
+template<typename Real, typename Narrow>
+void KineticSolver<Real, Narrow>::dropStaleEvents()
+{	// Stale events pile up between rebuilds, so they are cleared out before the queue would grow. The order of the
+	// rest stays the same since ties are broken on the bodies. A queue still over half full has room made for it,
+	// so the clear outs stay rare.
+	_events.erase(std::remove_if(_events.begin(), _events.end(), [&](const Event& e) { return stale(e); }), _events.end());
+	std::make_heap(_events.begin(), _events.end(), std::greater<Event>());
+	if (_events.size() > _events.capacity() / 2)
+		_events.reserve(2 * _events.capacity());
+}
+
+template<typename Real, typename Narrow>
+bool KineticSolver<Real, Narrow>::stale(const Event& e) const
+{	// One of the bodies changed its motion since the event was predicted
+	return e.bodyCount != _counts[e.body] || (e.kind == PairEvent && e.otherCount != _counts[e.other]);
+}
+
+template<typename Real, typename Narrow>
+double KineticSolver<Real, Narrow>::separation(Polygon<Real>& a, Polygon<Real>& b, Point<double>& axis)
+{	// Widest gap along any edge normal of either shape, negative when they overlap, with its axis pointing from a to b.
+	// A gap along one axis is never more than the distance between the shapes.
+	double gap = std::numeric_limits<double>::lowest();
+	for (auto* shape : { &a, &b }) {
+		auto& corners = shape->vertices();
+		Point<Real> prev = corners.back();
+		for (auto& corner : corners) {
+			auto edgeNormal = normal(corner, prev);
+			auto aProjection = project(a.vertices(), edgeNormal);
+			auto bProjection = project(b.vertices(), edgeNormal);
+			double forward = bProjection.min - aProjection.max;
+			double backward = aProjection.min - bProjection.max;
+			if (max(forward, backward) > gap) {
+				gap = max(forward, backward);
+				double sign = forward >= backward ? 1 : -1;
+				axis = { sign * edgeNormal.x, sign * edgeNormal.y };
+			}
+			prev = corner;
+		}
+	}
+	return gap;
+}
+
+template<typename Real, typename Narrow>
+typename KineticSolver<Real, Narrow>::BodyState KineticSolver<Real, Narrow>::state(const Polygon<Real>& p)
+{
+	return { p.xPos(), p.yPos(), p.angle(), p.xVelocity(), p.yVelocity(), p.angleVelocity() };
+}
+
+template<typename Real, typename Narrow>
+bool KineticSolver<Real, Narrow>::sameState(const BodyState& a, const BodyState& b)
+{
+	return a.x == b.x && a.y == b.y && a.angle == b.angle && a.xVel == b.xVel && a.yVel == b.yVel && a.angleVel == b.angleVel;
+}
+
+template class KineticSolver<float>;
+template class KineticSolver<double>;
+template class KineticSolver<double, float>;
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "Polygon.h"
+#include "CollisionManager.h"
+#include "SpatialGrid.h"
+
+// Event driven stepping for sparse scenes of constant velocity bodies. Collision times of bounding circles,
+// walls and grid cell crossings wait in a priority queue and the bodies jump from one event to the next,
+// so a step costs per event instead of per body and pair. Static geometry is not seen in this mode, and World
+// refuses it on periodic axes, since no pairs are predicted across the seam.
+template<typename Real, typename Narrow = Real>
+class KineticSolver
+{
+public:
+	//Constructor
+	KineticSolver(int width, int height);
+	//Accessors
+	int eventsLastStep() const;		// Events that were still valid when their time came
+	//Functions
+	void step(std::vector<Polygon<Real>>& polygons, CollisionManager<Real, Narrow>& collisions, Real dt);
+	void invalidate();				// Predictions are rebuilt on the next step, also done when bodies change outside the solver
+private:
+	enum Event_Kind {
+		PairEvent,					// Bounding circles touch, or a close pair is due for another look
+		WallEvent,
+		CellEvent					// Center crosses into the cell in other
+	};
+	struct Event {
+		double time;
+		int body;
+		int other;					// Second body, or the new cell
+		Event_Kind kind;
+		unsigned int bodyCount;		// Event counters when predicted, the event is stale once either has moved on
+		unsigned int otherCount;
+		bool operator>(const Event& e) const;
+	};
+	struct BodyState {				// What the solver last left each body at, to notice changes made outside it
+		Real x;
+		Real y;
+		Real angle;
+		Real xVel;
+		Real yVel;
+		Real angleVel;
+	};
+
+	//Variables
+	int _width;
+	int _height;
+	double _time = 0;
+	bool _valid = false;
+	int _eventsLastStep = 0;
+	SpatialGrid _grid;				// Geometry of the cells only, membership lives in the lists below
+	std::vector<int> _cellHead;		// First body per cell, -1 when empty
+	std::vector<int> _next;			// Doubly linked body lists per cell
+	std::vector<int> _prev;
+	std::vector<int> _cell;
+	std::vector<double> _bodyTime;	// Time each body was last moved to
+	std::vector<unsigned int> _counts;	// Bumped whenever a body's motion changes, invalidating its events
+	std::vector<BodyState> _lastState;
+	std::vector<Event> _events;		// Heap with the earliest event at the front
+	//Private functions
+	bool changedOutside(const std::vector<Polygon<Real>>& polygons) const;
+	void rebuild(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions);
+	void advance(Polygon<Real>& p, int body, double time);
+	LinearAlgebra::Point<double> positionAt(const Polygon<Real>& p, int body, double time) const;
+	void predictBody(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions, int body, int skip);
+	void predictPair(std::vector<Polygon<Real>>& polygons, int a, int b);
+	void predictWall(std::vector<Polygon<Real>>& polygons, const CollisionManager<Real, Narrow>& collisions, int body);
+	void predictCell(const std::vector<Polygon<Real>>& polygons, int body);
+	void moveToCell(int body, int cell);
+	void push(Event_Kind kind, double time, int body, int other);
+	void dropStaleEvents();
+	bool stale(const Event& e) const;
+	static double separation(Polygon<Real>& a, Polygon<Real>& b, LinearAlgebra::Point<double>& axis);
+	static BodyState state(const Polygon<Real>& p);
+	static bool sameState(const BodyState& a, const BodyState& b);
+};
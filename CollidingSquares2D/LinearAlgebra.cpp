@@ -1,27 +1,62 @@
 #include "LinearAlgebra.h"
+#include "SimdKernels.h"
 #include <math.h>
+#if defined(SIMD_X86)
+#include <xmmintrin.h>
+#endif
 
-double LinearAlgebra::dot(const Point& a, const Point& b)
+template<typename Real>
+Real LinearAlgebra::inverseSqrt(Real x, bool fast)
+{
+#if defined(SIMD_X86)
+	if (fast)
+	{	// rsqrtss is good to 1.5 * 2^-12, a Newton step squares that down to about 2e-7
+		Real y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(float(x))));
+		return y * (Real(1.5) - Real(0.5) * x * y * y);
+	}
+#endif
+	return 1 / sqrt(x);
+}
+
+template<typename Real>
+Real LinearAlgebra::dot(const Point<Real>& a, const Point<Real>& b)
 {
 	return a.x * b.x + a.y * b.y;
 }
 
-double LinearAlgebra::cross(const Point& a, const Point& b)
+template<typename Real>
+Real LinearAlgebra::cross(const Point<Real>& a, const Point<Real>& b)
 {
 	return a.x * b.y - a.y * b.x;
 }
 
-LinearAlgebra::Point LinearAlgebra::normal(const Point& a, const Point& b)
+template<typename Real>
+LinearAlgebra::Point<Real> LinearAlgebra::normal(const Point<Real>& a, const Point<Real>& b, bool fast)
 {
-	double dx = b.x - a.x;
-	double dy = b.y - a.y;
-	double invLength = 1/sqrt(dx * dx + dy * dy);
+	Real dx = b.x - a.x;
+	Real dy = b.y - a.y;
+	Real invLength = inverseSqrt(dx * dx + dy * dy, fast);
 	return {-dy * invLength, dx * invLength};			// Investigate where - sign comes from
 }
 
-LinearAlgebra::Projection LinearAlgebra::project(const std::vector<Point>& polygonCorners, const Point& vector)
+template<typename Real>
+LinearAlgebra::Point<Real> LinearAlgebra::direction(const Point<Real>& from, const Point<Real>& to, bool fast)
+{	// Unit vector from one point towards another
+	Real dx = to.x - from.x;
+	Real dy = to.y - from.y;
+	if (!fast)
+	{
+		Real length = sqrt(dx * dx + dy * dy);
+		return {dx / length, dy / length};
+	}
+	Real invLength = inverseSqrt(dx * dx + dy * dy, fast);
+	return {dx * invLength, dy * invLength};
+}
+
+template<typename Real>
+LinearAlgebra::Projection<Real> LinearAlgebra::project(const std::vector<Point<Real>>& polygonCorners, const Point<Real>& vector)
 {
-	Projection proj;
+	Projection<Real> proj;
 	for (auto& vertex : polygonCorners) {
 		auto length = dot(vertex, vector);
 		if (length > proj.max)
@@ -32,7 +67,21 @@ LinearAlgebra::Projection LinearAlgebra::project(const std::vector<Point>& polyg
 	return proj;
 }
 
-bool LinearAlgebra::overlap(const Projection& a, const Projection& b)
+template<typename Real>
+bool LinearAlgebra::overlap(const Projection<Real>& a, const Projection<Real>& b)
 {
 	return !(a.max < b.min || b.max < a.min);
 }
+
+// Single and double precision builds
+#define LINEAR_ALGEBRA_INSTANTIATE(Real) \
+	template Real LinearAlgebra::inverseSqrt(Real, bool); \
+	template Real LinearAlgebra::dot(const Point<Real>&, const Point<Real>&); \
+	template Real LinearAlgebra::cross(const Point<Real>&, const Point<Real>&); \
+	template LinearAlgebra::Point<Real> LinearAlgebra::normal(const Point<Real>&, const Point<Real>&, bool); \
+	template LinearAlgebra::Point<Real> LinearAlgebra::direction(const Point<Real>&, const Point<Real>&, bool); \
+	template LinearAlgebra::Projection<Real> LinearAlgebra::project(const std::vector<Point<Real>>&, const Point<Real>&); \
+	template bool LinearAlgebra::overlap(const Projection<Real>&, const Projection<Real>&);
+
+LINEAR_ALGEBRA_INSTANTIATE(float)
+LINEAR_ALGEBRA_INSTANTIATE(double)
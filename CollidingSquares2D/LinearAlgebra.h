@@ -4,20 +4,27 @@
 
 namespace LinearAlgebra {
 
+	template<typename Real>
 	struct Point {
-		double x = 0;
-		double y = 0;
+		Real x = 0;
+		Real y = 0;
 	};
 
+	template<typename Real>
 	struct Projection {
-		double max = std::numeric_limits<double>::lowest();
-		double min = std::numeric_limits<double>::max();
+		Real max = std::numeric_limits<Real>::lowest();
+		Real min = std::numeric_limits<Real>::max();
 	};
 
-	double dot(const Point& a, const Point& b);
-	double cross(const Point& a, const Point& b);
-	Point normal(const Point& a, const Point& b);
-	Projection project(const std::vector<Point>& polygonCorners, const Point& vector);
-	bool overlap(const Projection& a, const Projection& b);
+	// fast swaps 1/sqrt for the hardware estimate refined by one Newton step, relative error below 5e-7.
+	// Without fast, or off x86, results are the exact ones.
+	template<typename Real> Real inverseSqrt(Real x, bool fast = false);
+
+	template<typename Real> Real dot(const Point<Real>& a, const Point<Real>& b);
+	template<typename Real> Real cross(const Point<Real>& a, const Point<Real>& b);
+	template<typename Real> Point<Real> normal(const Point<Real>& a, const Point<Real>& b, bool fast = false);
+	template<typename Real> Point<Real> direction(const Point<Real>& from, const Point<Real>& to, bool fast = false);
+	template<typename Real> Projection<Real> project(const std::vector<Point<Real>>& polygonCorners, const Point<Real>& vector);
+	template<typename Real> bool overlap(const Projection<Real>& a, const Projection<Real>& b);
 }
 
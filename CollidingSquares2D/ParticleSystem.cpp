@@ -0,0 +1,458 @@
+#define _USE_MATH_DEFINES
+#include "ParticleSystem.h"
+#include <math.h>
+#include <algorithm>
+#include <limits>
+using namespace LinearAlgebra;
+using std::min;
+using std::max;
+
+template<typename Real>
+void ParticleSystem<Real>::Arrays::resize(int size)
+{
+	x.resize(size);
+	y.resize(size);
+	xVel.resize(size);
+	yVel.resize(size);
+	radius.resize(size);
+	invMass.resize(size);
+	id.resize(size);
+}
+
+template<typename Real>
+ParticleSystem<Real>::ParticleSystem(int width, int height)
+{
+	_width = width;
+	_height = height;
+}
+
+template<typename Real>
+int ParticleSystem<Real>::size() const
+{
+	return _particles.x.size();
+}
+
+template<typename Real>
+const Real* ParticleSystem<Real>::xPositions() const
+{
+	return _particles.x.data();
+}
+
+template<typename Real>
+const Real* ParticleSystem<Real>::yPositions() const
+{
+	return _particles.y.data();
+}
+
+template<typename Real>
+const Real* ParticleSystem<Real>::xVelocities() const
+{
+	return _particles.xVel.data();
+}
+
+template<typename Real>
+const Real* ParticleSystem<Real>::yVelocities() const
+{
+	return _particles.yVel.data();
+}
+
+template<typename Real>
+const Real* ParticleSystem<Real>::radii() const
+{
+	return _particles.radius.data();
+}
+
+template<typename Real>
+const int* ParticleSystem<Real>::ids() const
+{
+	return _particles.id.data();
+}
+
+template<typename Real>
+int ParticleSystem<Real>::addParticle(Real x, Real y, Real xVel, Real yVel, Real radius, Real density)
+{	// Mass from the disc's area, like the polygons get theirs from their own area
+	int id = size();
+	_particles.x.push_back(x);
+	_particles.y.push_back(y);
+	_particles.xVel.push_back(xVel);
+	_particles.yVel.push_back(yVel);
+	_particles.radius.push_back(radius);
+	_particles.invMass.push_back(Real(1 / (density * M_PI * radius * radius)));
+	_particles.id.push_back(id);
+	_maxRadius = max(_maxRadius, double(radius));
+	return id;
+}
+
+template<typename Real>
+void ParticleSystem<Real>::clear()
+{
+	_particles.resize(0);
+	_maxRadius = 0;
+}
+
+template<typename Real>
+void ParticleSystem<Real>::setPositionCorrection(Real baumgarte, Real slop)
+{	// Same meaning as for the polygons, see CollisionManager::setPositionCorrection
+	_baumgarte = baumgarte;
+	_slop = slop;
+}
+
+template<typename Real>
+void ParticleSystem<Real>::setPeriodic(bool x, bool y)
+{
+	_periodicX = x;
+	_periodicY = y;
+}
+
+template<typename Real>
+void ParticleSystem<Real>::step(std::vector<Polygon<Real>>& polygons, bool walls, ThreadPool& threads, Real dt)
+{	// Rows of cells touch only themselves and the row below, so even rows run side by side, then odd rows.
+	// Each row is worked through in order, so the result does not depend on the thread count.
+	// Across a periodic seam the last row touches the first, with an odd count it would share it with row 0
+	// in the even phase, so it runs on its own after both phases.
+	if (size() == 0)
+		return;
+
+	sortIntoCells();
+	int rows = _seamY && _rows % 2 == 1 ? _rows - 1 : _rows;
+	for (int parity = 0; parity < 2; parity++) {
+		threads.run((rows - parity + 1) / 2, [&](int task) {
+			collideRow(2 * task + parity);
+		});
+	}
+	if (rows < _rows)
+		collideRow(_rows - 1);
+
+	for (auto& polygon : polygons)
+		collidePolygon(polygon);
+
+	int n = size();
+	threads.run((n + IntegrateChunk - 1) / IntegrateChunk, [&](int task) {
+		integrate(walls, dt, task * IntegrateChunk, min(n, (task + 1) * IntegrateChunk));
+	});
+}
+
+template<typename Real>
+void ParticleSystem<Real>::sortIntoCells()
+{	// Cells as small as the widest touching pair allows, but no more than about four per particle in sparse scenes.
+	// A counting sort then moves the particles into cell order, so a cell and its neighbours are next to each other.
+	int n = size();
+	double cellSize = max(2 * _maxRadius, sqrt(0.25 * _width * _height / n));
+	_columns = max(1, (int)(_width / cellSize));
+	_rows = max(1, (int)(_height / cellSize));
+	_cellWidth = double(_width) / _columns;
+	_cellHeight = double(_height) / _rows;
+	_seamX = _periodicX && _columns >= 3;
+	_seamY = _periodicY && _rows >= 3;
+
+	_cell.resize(n);
+	_sortedCell.resize(n);
+	_cellStart.assign(_columns * _rows + 1, 0);
+	Real inverseWidth = Real(1 / _cellWidth);
+	Real inverseHeight = Real(1 / _cellHeight);
+	for (int i = 0; i < n; i++)
+		_cell[i] = cellIndex(_particles.x[i] * inverseWidth, _particles.y[i] * inverseHeight);
+	for (int i = 0; i < n; i++)
+		_cellStart[_cell[i] + 1]++;
+	for (int cell = 0; cell < _columns * _rows; cell++)
+		_cellStart[cell + 1] += _cellStart[cell];
+
+	_sorted.resize(n);
+	_fill.assign(_cellStart.begin(), _cellStart.end() - 1);
+	for (int i = 0; i < n; i++) {
+		int to = _fill[_cell[i]]++;
+		_sorted.x[to] = _particles.x[i];
+		_sorted.y[to] = _particles.y[i];
+		_sorted.xVel[to] = _particles.xVel[i];
+		_sorted.yVel[to] = _particles.yVel[i];
+		_sorted.radius[to] = _particles.radius[i];
+		_sorted.invMass[to] = _particles.invMass[i];
+		_sorted.id[to] = _particles.id[i];
+		_sortedCell[to] = _cell[i];
+	}
+	std::swap(_particles, _sorted);
+	std::swap(_cell, _sortedCell);
+}
+
+template<typename Real>
+void ParticleSystem<Real>::collideRow(int row)
+{	// Pairs whose upper left cell is in this row: the particle's own cell after it and the next cell along,
+	// both one range, then the three cells below, also one range. Walked by particle, empty cells cost nothing.
+	// Across a periodic seam the partners are shifted by the world size, below the last row is the first row
+	// and next to the last column the first column, those are looked at once the plain pairs are done.
+	int rowStart = row * _columns;
+	int last = _cellStart[rowStart + _columns];
+	bool lastRow = row + 1 == _rows;
+	Real yShift = Real(_height);
+	for (int i = _cellStart[rowStart]; i < last; i++) {
+		int cell = _cell[i];
+		int column = cell - rowStart;
+		bool lastColumn = column + 1 == _columns;
+		int alongEnd = _cellStart[lastColumn ? cell + 1 : cell + 2];
+		for (int j = i + 1; j < alongEnd; j++)
+			collidePair<false>(i, j, 0, 0);
+
+		if (!lastRow)
+		{
+			int below = cell + _columns;
+			int belowEnd = _cellStart[lastColumn ? below + 1 : below + 2];
+			for (int j = _cellStart[column > 0 ? below - 1 : below]; j < belowEnd; j++)
+				collidePair<false>(i, j, 0, 0);
+		}
+		else if (_seamY)
+			collideCells(i, column > 0 ? column - 1 : column, lastColumn ? column : column + 1, 0, yShift);
+	}
+
+	if (_seamX)
+	{
+		bool below = !lastRow || _seamY;
+		int belowStart = lastRow ? 0 : rowStart + _columns;
+		Real belowShift = lastRow ? yShift : 0;
+		int lastCell = rowStart + _columns - 1;
+		for (int i = _cellStart[lastCell]; i < _cellStart[lastCell + 1]; i++) {
+			collideCells(i, rowStart, rowStart, Real(_width), 0);
+			if (below)
+				collideCells(i, belowStart, belowStart, Real(_width), belowShift);
+		}
+		if (below)
+		{
+			for (int i = _cellStart[rowStart]; i < _cellStart[rowStart + 1]; i++)
+				collideCells(i, belowStart + _columns - 1, belowStart + _columns - 1, -Real(_width), belowShift);
+		}
+	}
+}
+
+template<typename Real>
+void ParticleSystem<Real>::collideCells(int i, int first, int last, Real xShift, Real yShift)
+{	// Particle i against every particle in cells first to last of one row
+	int end = _cellStart[last + 1];
+	for (int j = _cellStart[first]; j < end; j++)
+		collidePair<true>(i, j, xShift, yShift);
+}
+
+template<typename Real>
+template<bool Shifted>
+void ParticleSystem<Real>::collidePair(int i, int j, Real xShift, Real yShift)
+{	// Elastic impulse along the line between the centers for approaching pairs, then the overlap beyond
+	// the slop pushed out split by inverse mass, without touching the velocities. A shifted pair has j moved to
+	// its copy across a periodic seam, the plain pairs in the hot loop skip the adds.
+	auto& p = _particles;
+	Real dx = Shifted ? p.x[i] - (p.x[j] + xShift) : p.x[i] - p.x[j];
+	Real dy = Shifted ? p.y[i] - (p.y[j] + yShift) : p.y[i] - p.y[j];
+	Real rSum = p.radius[i] + p.radius[j];
+	Real distanceSquared = dx * dx + dy * dy;
+	if (distanceSquared >= rSum * rSum)
+		return;
+
+	Real C_R = 1;
+	Real distance = sqrt(distanceSquared);
+	Point<Real> n = distance > 0 ? Point<Real>{ dx / distance, dy / distance } : Point<Real>{ 1, 0 };
+	Real invMassSum = p.invMass[i] + p.invMass[j];
+	Real approach = (p.xVel[i] - p.xVel[j]) * n.x + (p.yVel[i] - p.yVel[j]) * n.y;
+	if (approach < 0)
+	{
+		Real impulse = -(1 + C_R) * approach / invMassSum;
+		p.xVel[i] += impulse * p.invMass[i] * n.x;
+		p.yVel[i] += impulse * p.invMass[i] * n.y;
+		p.xVel[j] -= impulse * p.invMass[j] * n.x;
+		p.yVel[j] -= impulse * p.invMass[j] * n.y;
+	}
+
+	Real correction = _baumgarte * (rSum - distance - _slop);
+	if (correction > 0)
+	{
+		Real move = correction / invMassSum;
+		p.x[i] += move * p.invMass[i] * n.x;
+		p.y[i] += move * p.invMass[i] * n.y;
+		p.x[j] -= move * p.invMass[j] * n.x;
+		p.y[j] -= move * p.invMass[j] * n.y;
+	}
+}
+
+template<typename Real>
+void ParticleSystem<Real>::collidePolygon(Polygon<Real>& polygon)
+{	// Particles in the cells under the polygon's bounding circle. On a periodic axis the cells past the edge
+	// come from the other side, with the particles shifted over to the polygon.
+	auto& corners = polygon.vertices();
+	int count = corners.size();
+	Point<Real> center = { polygon.xPos(), polygon.yPos() };
+	_normals.resize(count);
+	for (int k = 0; k < count; k++) {
+		auto& from = corners[k];
+		auto& to = corners[(k + 1) % count];
+		Point<Real> n = normal(to, from);
+		Point<Real> middle = { (from.x + to.x) / 2 - center.x, (from.y + to.y) / 2 - center.y };
+		_normals[k] = dot(n, middle) < 0 ? Point<Real>{ -n.x, -n.y } : n;
+	}
+
+	// Cell span along one axis as pieces that do not cross the edge, each with how many periods it is off by
+	auto pieces = [](double low, double high, double cell, int cells, bool periodic, int (&piece)[3][3]) {
+		int first = (int)floor(low / cell);
+		int last = (int)floor(high / cell);
+		if (!periodic)
+		{
+			piece[0][0] = max(0, min(cells - 1, first));
+			piece[0][1] = max(0, min(cells - 1, last));
+			piece[0][2] = 0;
+			return 1;
+		}
+		last = min(last, first + cells - 1);
+		int count = 0;
+		for (int c = first; c <= last; count++) {
+			int period = (int)floor(double(c) / cells);
+			int end = min(last, (period + 1) * cells - 1);
+			piece[count][0] = c - period * cells;
+			piece[count][1] = end - period * cells;
+			piece[count][2] = period;
+			c = end + 1;
+		}
+		return count;
+	};
+	double reach = polygon.vertexRadius() + _maxRadius;
+	int columnPieces[3][3];
+	int rowPieces[3][3];
+	int columnCount = pieces(center.x - reach, center.x + reach, _cellWidth, _columns, _periodicX, columnPieces);
+	int rowCount = pieces(center.y - reach, center.y + reach, _cellHeight, _rows, _periodicY, rowPieces);
+	for (int r = 0; r < rowCount; r++) {
+		for (int row = rowPieces[r][0]; row <= rowPieces[r][1]; row++) {
+			for (int c = 0; c < columnCount; c++) {
+				int first = _cellStart[row * _columns + columnPieces[c][0]];
+				int last = _cellStart[row * _columns + columnPieces[c][1] + 1];
+				collidePolygonRange(polygon, first, last, Real(columnPieces[c][2] * _width), Real(rowPieces[r][2] * _height));
+			}
+		}
+	}
+}
+
+template<typename Real>
+void ParticleSystem<Real>::collidePolygonRange(Polygon<Real>& polygon, int first, int last, Real xShift, Real yShift)
+{	// The nearest point of the polygon to a particle's center comes from the edge the center is furthest outside of,
+	// or that edge's nearest corner. Impulse as for two polygons with a particle that cannot turn, the overlap
+	// is split by inverse mass.
+	auto& p = _particles;
+	auto& corners = polygon.vertices();
+	int count = corners.size();
+	Point<Real> center = { polygon.xPos(), polygon.yPos() };
+	Real C_R = 1;
+	for (int i = first; i < last; i++) {
+		Real px = p.x[i] + xShift;
+		Real py = p.y[i] + yShift;
+		Real dx = px - center.x;
+		Real dy = py - center.y;
+		Real rSum = polygon.vertexRadius() + p.radius[i];
+		if (dx * dx + dy * dy >= rSum * rSum)
+			continue;
+
+		int edge = 0;
+		Real outside = std::numeric_limits<Real>::lowest();
+		for (int k = 0; k < count; k++) {
+			Real s = (px - corners[k].x) * _normals[k].x + (py - corners[k].y) * _normals[k].y;
+			if (s > outside)
+			{
+				outside = s;
+				edge = k;
+			}
+		}
+		if (outside >= p.radius[i])
+			continue;
+
+		// Past either end of the edge the nearest point is a corner
+		auto& from = corners[edge];
+		auto& to = corners[(edge + 1) % count];
+		Point<Real> along = { to.x - from.x, to.y - from.y };
+		Real t = ((px - from.x) * along.x + (py - from.y) * along.y) / dot(along, along);
+		Point<Real> n = _normals[edge];
+		Real depth = p.radius[i] - outside;
+		if (outside > 0 && (t < 0 || t > 1))
+		{
+			auto& corner = t < 0 ? from : to;
+			Real cx = px - corner.x;
+			Real cy = py - corner.y;
+			Real distance = sqrt(cx * cx + cy * cy);
+			if (distance >= p.radius[i] || distance == 0)
+				continue;
+			n = { cx / distance, cy / distance };
+			depth = p.radius[i] - distance;
+		}
+
+		Point<Real> contact = { px - n.x * (p.radius[i] - depth), py - n.y * (p.radius[i] - depth) };
+		Point<Real> R = { contact.x - center.x, contact.y - center.y };
+		Real RxN = cross(R, n);
+		Real invMass = 1 / polygon.mass();
+		Real invMassSum = p.invMass[i] + invMass + polygon.invInertia() * RxN * RxN;
+		Point<Real> polygonVel = { polygon.xVelocity() - polygon.angleVelocity() * R.y, polygon.yVelocity() + polygon.angleVelocity() * R.x };
+		Real approach = (p.xVel[i] - polygonVel.x) * n.x + (p.yVel[i] - polygonVel.y) * n.y;
+		if (approach < 0)
+		{
+			Real impulse = -(1 + C_R) * approach / invMassSum;
+			p.xVel[i] += impulse * p.invMass[i] * n.x;
+			p.yVel[i] += impulse * p.invMass[i] * n.y;
+			polygon.setVelocity(polygon.xVelocity() - impulse * invMass * n.x, polygon.yVelocity() - impulse * invMass * n.y,
+				polygon.angleVelocity() - polygon.invInertia() * RxN * impulse);
+		}
+
+		Real correction = _baumgarte * (depth - _slop);
+		if (correction > 0)
+		{
+			Real move = correction / (p.invMass[i] + invMass);
+			p.x[i] += move * p.invMass[i] * n.x;
+			p.y[i] += move * p.invMass[i] * n.y;
+			polygon.setPosition(polygon.xPos() - move * invMass * n.x, polygon.yPos() - move * invMass * n.y);
+		}
+	}
+}
+
+template<typename Real>
+void ParticleSystem<Real>::integrate(bool walls, Real dt, int first, int last)
+{	// Walls reflect the velocity and put the particle back against the wall, then a straight move and periodic
+	// axes wrap the particle back into the world. Selects instead of branches, so the loops vectorise.
+	auto& p = _particles;
+	Real width = _width;
+	Real height = _height;
+	if (walls && !_periodicX)
+	{
+		for (int i = first; i < last; i++) {
+			Real r = p.radius[i];
+			Real speed = abs(p.xVel[i]);
+			p.xVel[i] = p.x[i] < r ? speed : (p.x[i] > width - r ? -speed : p.xVel[i]);
+			p.x[i] = min(max(p.x[i], r), width - r);
+		}
+	}
+	if (walls && !_periodicY)
+	{
+		for (int i = first; i < last; i++) {
+			Real r = p.radius[i];
+			Real speed = abs(p.yVel[i]);
+			p.yVel[i] = p.y[i] < r ? speed : (p.y[i] > height - r ? -speed : p.yVel[i]);
+			p.y[i] = min(max(p.y[i], r), height - r);
+		}
+	}
+
+	for (int i = first; i < last; i++) {
+		p.x[i] += p.xVel[i] * dt;
+		p.y[i] += p.yVel[i] * dt;
+	}
+
+	if (_periodicX)
+	{
+		for (int i = first; i < last; i++)
+			p.x[i] -= width * floor(p.x[i] / width);
+	}
+	if (_periodicY)
+	{
+		for (int i = first; i < last; i++)
+			p.y[i] -= height * floor(p.y[i] / height);
+	}
+}
+
+template<typename Real>
+int ParticleSystem<Real>::cellIndex(Real column, Real row) const
+{	// Position already in cells. Particles outside the world count to the border cells, truncating toward zero
+	// is fine since anything below zero ends up in the first cell either way.
+	int c = max(0, min(_columns - 1, (int)column));
+	int r = max(0, min(_rows - 1, (int)row));
+	return r * _columns + c;
+}
+
+template class ParticleSystem<float>;
+template class ParticleSystem<double>;
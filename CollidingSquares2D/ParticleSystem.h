@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include "Polygon.h"
+#include "LinearAlgebra.h"
+#include "ThreadPool.h"
+
+// Round grains without rotation, position, velocity and radius only, kept as separate arrays.
+// Every step they are sorted into a grid of their own, collide with each other a cell row at a time,
+// then with the polygons and the walls, or wrap round periodic axes. Long range forces are not seen by particles.
+template<typename Real>
+class ParticleSystem
+{
+public:
+	//Constructor
+	ParticleSystem(int width, int height);
+	//Accessors
+	int size() const;
+	const Real* xPositions() const;
+	const Real* yPositions() const;
+	const Real* xVelocities() const;
+	const Real* yVelocities() const;
+	const Real* radii() const;
+	const int* ids() const;				// Particles are kept in grid order, ids are the order they were added in
+	//Functions
+	int addParticle(Real x, Real y, Real xVel, Real yVel, Real radius, Real density = 1);
+	void clear();
+	void setPositionCorrection(Real baumgarte, Real slop);
+	void setPeriodic(bool x, bool y);	// As for the polygons, World keeps both the same
+	void step(std::vector<Polygon<Real>>& polygons, bool walls, ThreadPool& threads, Real dt);	// Also integrates the particles
+private:
+	struct Arrays {
+		std::vector<Real> x;
+		std::vector<Real> y;
+		std::vector<Real> xVel;
+		std::vector<Real> yVel;
+		std::vector<Real> radius;
+		std::vector<Real> invMass;
+		std::vector<int> id;
+		void resize(int size);
+	};
+	static const int IntegrateChunk = 4096;	// Particles per task, fixed so the split never depends on the thread count
+
+	//Variables
+	int _width;
+	int _height;
+	Real _baumgarte = Real(0.8);		// Share of the overlap beyond the slop removed per step
+	Real _slop = Real(0.1);
+	double _maxRadius = 0;
+	bool _periodicX = false;
+	bool _periodicY = false;
+	bool _seamX = false;				// Pairs are looked for across the seam, needs 3 cells along the axis
+	bool _seamY = false;
+	Arrays _particles;
+	Arrays _sorted;						// Counting sort target, swapped with _particles
+	int _columns = 0;
+	int _rows = 0;
+	double _cellWidth = 0;				// The world split into whole cells, so a periodic axis wraps onto a cell border
+	double _cellHeight = 0;
+	std::vector<int> _cell;				// Per particle, in grid order once sorted
+	std::vector<int> _sortedCell;
+	std::vector<int> _cellStart;		// Offsets into the particles, one past the end per cell
+	std::vector<int> _fill;				// Next free slot per cell while sorting
+	std::vector<LinearAlgebra::Point<Real>> _normals;	// Outward edge normals of the polygon being tested
+	//Private functions
+	void sortIntoCells();
+	void collideRow(int row);
+	template<bool Shifted> void collidePair(int i, int j, Real xShift, Real yShift);
+	void collideCells(int i, int first, int last, Real xShift, Real yShift);
+	void collidePolygon(Polygon<Real>& p);
+	void collidePolygonRange(Polygon<Real>& p, int first, int last, Real xShift, Real yShift);
+	void integrate(bool walls, Real dt, int first, int last);
+	int cellIndex(Real column, Real row) const;
+};
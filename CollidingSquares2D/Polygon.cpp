@@ -1,24 +1,69 @@
 #include "Polygon.h"
 #include "Dice.h"
+#include "SimdKernels.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <map>
+#include <mutex>
 
 using LinearAlgebra::Point;
 
-Polygon::Polygon(double vertexRadius, int nbrOfCorners, double density)
+template<typename Real>
+static std::vector<Real> buildUnitCorners(int nbrOfCorners)
+{	// Sines then negated cosines of the corner angles
+	std::vector<Real> table(2 * nbrOfCorners);
+	for (int i = 0; i < nbrOfCorners; i++) {
+		table[i] = Real(sin(i * 2 * M_PI / nbrOfCorners));
+		table[nbrOfCorners + i] = Real(-cos(i * 2 * M_PI / nbrOfCorners));
+	}
+	return table;
+}
+
+template<typename Real>
+struct UnitCornerTables {
+	static const int Prebuilt = 8;		// 3 to Prebuilt corners are built up front, the rest on first use
+	std::vector<Real> prebuilt[Prebuilt + 1];
+	std::map<int, std::vector<Real>> others;
+	std::mutex mutex;
+
+	UnitCornerTables()
+	{
+		for (int corners = 3; corners <= Prebuilt; corners++)
+			prebuilt[corners] = buildUnitCorners<Real>(corners);
+	}
+};
+
+template<typename Real>
+static const Real* unitCorners(int nbrOfCorners)
+{	// Polygons may be built on several threads. The common tables are read only after the static is initialised,
+	// which is thread safe, and the rare ones are added under a lock, map nodes never move once in place.
+	static UnitCornerTables<Real> tables;
+	if (nbrOfCorners >= 3 && nbrOfCorners <= UnitCornerTables<Real>::Prebuilt)
+		return tables.prebuilt[nbrOfCorners].data();
+
+	std::lock_guard<std::mutex> lock(tables.mutex);
+	auto& table = tables.others[nbrOfCorners];
+	if (table.empty())
+		table = buildUnitCorners<Real>(nbrOfCorners);
+	return table.data();
+}
+
+template<typename Real>
+Polygon<Real>::Polygon(Real vertexRadius, int nbrOfCorners, Real density)
 {
 	_vertexRadius = vertexRadius;
 	_nbrOfCorners = nbrOfCorners;
 
-	double apothem = _vertexRadius * cos(M_PI / _nbrOfCorners);
-	double area = apothem * apothem * _nbrOfCorners * tan(M_PI / _nbrOfCorners) * 0.5;
+	Real apothem = _vertexRadius * cos(Real(M_PI) / _nbrOfCorners);
+	Real area = apothem * apothem * _nbrOfCorners * tan(Real(M_PI) / _nbrOfCorners) * Real(0.5);
 	_mass = density * area;
 
 	_inertia = (_mass * _vertexRadius * _vertexRadius / 6) *
-		(sin(M_PI / _nbrOfCorners) * sin(M_PI / _nbrOfCorners) + 3 * cos(M_PI / _nbrOfCorners) * cos(M_PI / _nbrOfCorners));
+		(sin(Real(M_PI) / _nbrOfCorners) * sin(Real(M_PI) / _nbrOfCorners) + 3 * cos(Real(M_PI) / _nbrOfCorners) * cos(Real(M_PI) / _nbrOfCorners));
 	_inv_inertia = 1 / _inertia;
 
-	_vertices = std::vector<Point>(_nbrOfCorners);
+	_vertices = std::vector<Point<Real>>(_nbrOfCorners);
+	_unitCorners = unitCorners<Real>(_nbrOfCorners);
 	_shape = sf::CircleShape(_vertexRadius, _nbrOfCorners);
 	_shape.setOrigin(_vertexRadius, _vertexRadius);
 
@@ -28,108 +73,121 @@ Polygon::Polygon(double vertexRadius, int nbrOfCorners, double density)
 	_shape.setFillColor(sf::Color(r, g, b));
 }
 
-const sf::CircleShape& Polygon::shape() const
+template<typename Real>
+const sf::CircleShape& Polygon<Real>::shape() const
 {
 	return _shape;
 }
 
-double Polygon::mass() const
+template<typename Real>
+Real Polygon<Real>::mass() const
 {
 	return _mass;
 }
 
-double Polygon::invInertia() const
+template<typename Real>
+Real Polygon<Real>::invInertia() const
 {
 	return _inv_inertia;
 }
 
-double Polygon::vertexRadius() const
+template<typename Real>
+Real Polygon<Real>::vertexRadius() const
 {
 	return _vertexRadius;
 }
 
-const std::vector<LinearAlgebra::Point>& Polygon::vertices()
+template<typename Real>
+int Polygon<Real>::nbrOfCorners() const
+{
+	return _nbrOfCorners;
+}
+
+template<typename Real>
+const std::vector<LinearAlgebra::Point<Real>>& Polygon<Real>::vertices()
 {
 	return _vertices;
 }
 
-double Polygon::xPos() const
+template<typename Real>
+Real Polygon<Real>::xPos() const
 {
-	return _shape.getPosition().x;
+	return _xPos;
 }
 
-double Polygon::yPos() const
+template<typename Real>
+Real Polygon<Real>::yPos() const
 {
-	return _shape.getPosition().y;
+	return _yPos;
 }
 
-double Polygon::angle() const
+template<typename Real>
+Real Polygon<Real>::angle() const
 {
-	return _shape.getRotation() * M_PI / 180;
+	return _angle;
 }
 
-double Polygon::xVelocity() const
+template<typename Real>
+Real Polygon<Real>::xVelocity() const
 {
 	return _xVel;
 }
 
-double Polygon::yVelocity() const
+template<typename Real>
+Real Polygon<Real>::yVelocity() const
 {
 	return _yVel;
 }
 
-double Polygon::angleVelocity() const
+template<typename Real>
+Real Polygon<Real>::angleVelocity() const
 {
 	return _aVel;
 }
 
-bool Polygon::hasCollidedWith(const Polygon& p) const
-{
-	for (auto& polygon : _collisionsThisFrame) 
-	{
-		if (polygon == &p)
-			return true;
-	}
-	return false;
-}
-
-void Polygon::addPolygonColission(Polygon& p)
-{
-	_collisionsThisFrame.push_back(&p);
-}
-
-void Polygon::setVelocity(double x, double y, double a)
+template<typename Real>
+void Polygon<Real>::setVelocity(Real x, Real y, Real a)
 {
 	_xVel = x;
 	_yVel = y;
 	_aVel = a;
 }
 
-void Polygon::setPosition(double x, double y)
+template<typename Real>
+void Polygon<Real>::setPosition(Real x, Real y)
 {
-	_shape.setPosition(x, y);
+	_xPos = x;
+	_yPos = y;
+	_shape.setPosition(float(x), float(y));
+}
+
+template<typename Real>
+void Polygon<Real>::setAngle(Real angle)
+{	// Corners follow on the next updatePosition, like after setPosition
+	_angle = fmod(angle, Real(2 * M_PI));
+	if (_angle < 0)
+		_angle += Real(2 * M_PI);
+	_shape.setRotation(float(_angle * 180 / M_PI));
 }
 
-void Polygon::updatePosition(double dt)
+template<typename Real>
+void Polygon<Real>::updatePosition(Real dt)
 {
 	// Members
-	double dx = _xVel * dt;
-	double dy = _yVel * dt;
-	double da = _aVel * dt;
+	_xPos += _xVel * dt;
+	_yPos += _yVel * dt;
+	_angle = fmod(_angle + _aVel * dt, Real(2 * M_PI));
+	if (_angle < 0)
+		_angle += Real(2 * M_PI);
 
 	// Visuals
-	_shape.move(dx, dy);
-	_shape.rotate(da * 180 / M_PI);
-
-	// Corners
-	int i = 0;
-	double delta_angle = 2 * M_PI / _nbrOfCorners;
-	for (auto& vertex : _vertices) {
-		vertex.x = xPos() + _vertexRadius * sin(angle() + i * delta_angle);
-		vertex.y = yPos() + _vertexRadius * -cos(angle() + i * delta_angle);
-		i++;
-	}
+	_shape.setPosition(float(_xPos), float(_yPos));
+	_shape.setRotation(float(_angle * 180 / M_PI));
 
-	// Reset collisions
-	_collisionsThisFrame.clear();
+	// Corners, the unit polygon rotated and scaled by the widest kernel the CPU has
+	Simd::kernels<Real>().transformCorners(_unitCorners, _unitCorners + _nbrOfCorners, _nbrOfCorners,
+		_xPos, _yPos, _vertexRadius, cos(_angle), sin(_angle), &_vertices[0].x);
 }
+
+template class Polygon<float>;
+template class Polygon<double>;
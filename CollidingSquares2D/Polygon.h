@@ -4,41 +4,45 @@
 #include <SFML/Graphics.hpp>
 #include "LinearAlgebra.h"
 
+template<typename Real>
 class Polygon
 {
 public:
 	//Constructor
-	Polygon(double vertexRadius, int nbrOfCorners = 4, double density = 1);
+	Polygon(Real vertexRadius, int nbrOfCorners = 4, Real density = 1);
 	//Accessors
 	const sf::CircleShape& shape() const;
-	double mass() const;
-	double invInertia() const;
-	double vertexRadius() const;
-	const std::vector<LinearAlgebra::Point>& vertices();
-	double xPos() const;
-	double yPos() const;
-	double angle() const;
-	double xVelocity() const;
-	double yVelocity() const;
-	double angleVelocity() const;
-	bool hasCollidedWith(const Polygon& p) const;
-	void addPolygonColission(Polygon&);
+	Real mass() const;
+	Real invInertia() const;
+	Real vertexRadius() const;
+	int nbrOfCorners() const;
+	const std::vector<LinearAlgebra::Point<Real>>& vertices();
+	Real xPos() const;
+	Real yPos() const;
+	Real angle() const;
+	Real xVelocity() const;
+	Real yVelocity() const;
+	Real angleVelocity() const;
 	//Functions
-	void setVelocity(double x, double y, double a);
-	void setPosition(double x, double y);
-	void updatePosition(double dt);
+	void setVelocity(Real x, Real y, Real a);
+	void setPosition(Real x, Real y);
+	void setAngle(Real angle);
+	void updatePosition(Real dt);
 private:
 	//Variables
-	std::vector<LinearAlgebra::Point> _vertices;
-	double _vertexRadius;
+	std::vector<LinearAlgebra::Point<Real>> _vertices;
+	const Real* _unitCorners;		// Shared corners of the unit polygon, all x then all y
+	Real _vertexRadius;
 	int _nbrOfCorners;
-	double _mass;
-	double _inertia;
-	double _inv_inertia;
-	sf::CircleShape _shape;
-	double _xVel = 0;
-	double _yVel = 0;
-	double _aVel = 0;
-	std::vector<Polygon*> _collisionsThisFrame;
+	Real _mass;
+	Real _inertia;
+	Real _inv_inertia;
+	sf::CircleShape _shape;			// Float copy of the pose for drawing only
+	Real _xPos = 0;
+	Real _yPos = 0;
+	Real _angle = 0;
+	Real _xVel = 0;
+	Real _yVel = 0;
+	Real _aVel = 0;
 };
 
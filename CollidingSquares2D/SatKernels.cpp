@@ -0,0 +1,19 @@
+#include "SatKernels.h"
+
+#define SAT_KERNEL_ROW(N) { &sat<Real, N, 3>, &sat<Real, N, 4>, &sat<Real, N, 5>, &sat<Real, N, 6>, &sat<Real, N, 7>, &sat<Real, N, 8> }
+
+template<typename Real>
+SatKernels::Kernel<Real> SatKernels::kernel(int n, int m)
+{
+	static const Kernel<Real> table[MaxCorners - MinCorners + 1][MaxCorners - MinCorners + 1] = {
+		SAT_KERNEL_ROW(3), SAT_KERNEL_ROW(4), SAT_KERNEL_ROW(5),
+		SAT_KERNEL_ROW(6), SAT_KERNEL_ROW(7), SAT_KERNEL_ROW(8)
+	};
+
+	if (n < MinCorners || n > MaxCorners || m < MinCorners || m > MaxCorners)
+		return nullptr;
+	return table[n - MinCorners][m - MinCorners];
+}
+
+template SatKernels::Kernel<float> SatKernels::kernel<float>(int n, int m);
+template SatKernels::Kernel<double> SatKernels::kernel<double>(int n, int m);
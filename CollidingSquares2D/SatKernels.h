@@ -0,0 +1,101 @@
+#pragma once
+
+#include "LinearAlgebra.h"
+
+namespace SatKernels {
+
+	// Separating axes of the unit regular polygons built by Polygon, at angle 0.
+	// Even corner counts have parallel opposite edges, so only half their axes are distinct.
+	constexpr double unitAxes3[3][2] = { { -0.8660254037844386, -0.5 }, { 0.8660254037844386, -0.5 }, { 0, 1 } };
+	constexpr double unitAxes4[2][2] = { { -0.7071067811865476, -0.7071067811865476 }, { 0.7071067811865476, -0.7071067811865476 } };
+	constexpr double unitAxes5[5][2] = { { -0.5877852522924731, -0.8090169943749475 }, { 0.5877852522924731, -0.8090169943749475 },
+		{ 0.9510565162951536, 0.3090169943749474 }, { 0, 1 }, { -0.9510565162951536, 0.3090169943749474 } };
+	constexpr double unitAxes6[3][2] = { { -0.5, -0.8660254037844386 }, { 0.5, -0.8660254037844386 }, { 1, 0 } };
+	constexpr double unitAxes7[7][2] = { { -0.4338837391175581, -0.9009688679024191 }, { 0.4338837391175581, -0.9009688679024191 },
+		{ 0.9749279121818236, -0.2225209339563144 }, { 0.7818314824680298, 0.6234898018587336 }, { 0, 1 },
+		{ -0.7818314824680298, 0.6234898018587336 }, { -0.9749279121818236, -0.2225209339563144 } };
+	constexpr double unitAxes8[4][2] = { { -0.3826834323650898, -0.9238795325112867 }, { 0.3826834323650898, -0.9238795325112867 },
+		{ 0.9238795325112867, -0.3826834323650898 }, { 0.9238795325112867, 0.3826834323650898 } };
+
+	const int MinCorners = 3;
+	const int MaxCorners = 8;
+
+	template<int N> struct UnitAxes;
+	template<> struct UnitAxes<3> { static const int Count = 3; static const double (&axes())[3][2] { return unitAxes3; } };
+	template<> struct UnitAxes<4> { static const int Count = 2; static const double (&axes())[2][2] { return unitAxes4; } };
+	template<> struct UnitAxes<5> { static const int Count = 5; static const double (&axes())[5][2] { return unitAxes5; } };
+	template<> struct UnitAxes<6> { static const int Count = 3; static const double (&axes())[3][2] { return unitAxes6; } };
+	template<> struct UnitAxes<7> { static const int Count = 7; static const double (&axes())[7][2] { return unitAxes7; } };
+	template<> struct UnitAxes<8> { static const int Count = 4; static const double (&axes())[4][2] { return unitAxes8; } };
+
+	// Min and max of the corners projected on an axis, unrolled through recursion on the corner count
+	template<typename Real, int K>
+	struct Project {
+		static void run(const LinearAlgebra::Point<Real>* corners, Real nx, Real ny, Real& low, Real& high)
+		{
+			Project<Real, K - 1>::run(corners, nx, ny, low, high);
+			Real length = corners[K - 1].x * nx + corners[K - 1].y * ny;
+			low = length < low ? length : low;
+			high = length > high ? length : high;
+		}
+	};
+	template<typename Real>
+	struct Project<Real, 1> {
+		static void run(const LinearAlgebra::Point<Real>* corners, Real nx, Real ny, Real& low, Real& high)
+		{
+			low = high = corners[0].x * nx + corners[0].y * ny;
+		}
+	};
+
+	template<typename Real, int N, int M>
+	inline bool overlapOnAxis(const LinearAlgebra::Point<Real>* a, const LinearAlgebra::Point<Real>* b, Real nx, Real ny, Real& minOverlap)
+	{
+		Real aMin, aMax, bMin, bMax;
+		Project<Real, N>::run(a, nx, ny, aMin, aMax);
+		Project<Real, M>::run(b, nx, ny, bMin, bMax);
+		if (aMax < bMin || bMax < aMin)
+			return false;
+
+		Real overlap = (aMax < bMax ? aMax : bMax) - (aMin > bMin ? aMin : bMin);
+		minOverlap = overlap < minOverlap ? overlap : minOverlap;
+		return true;
+	}
+
+	// Axes of the K-gon rotated by (cos, sin) of its angle, tested one after the other
+	template<typename Real, int K, int N, int M, int Remaining = UnitAxes<K>::Count>
+	struct AxesOf {
+		static bool overlap(const LinearAlgebra::Point<Real>& rotation, const LinearAlgebra::Point<Real>* a, const LinearAlgebra::Point<Real>* b, Real& minOverlap)
+		{
+			const double* unit = UnitAxes<K>::axes()[UnitAxes<K>::Count - Remaining];
+			Real nx = Real(unit[0]) * rotation.x - Real(unit[1]) * rotation.y;
+			Real ny = Real(unit[0]) * rotation.y + Real(unit[1]) * rotation.x;
+			if (!overlapOnAxis<Real, N, M>(a, b, nx, ny, minOverlap))
+				return false;
+			return AxesOf<Real, K, N, M, Remaining - 1>::overlap(rotation, a, b, minOverlap);
+		}
+	};
+	template<typename Real, int K, int N, int M>
+	struct AxesOf<Real, K, N, M, 0> {
+		static bool overlap(const LinearAlgebra::Point<Real>&, const LinearAlgebra::Point<Real>*, const LinearAlgebra::Point<Real>*, Real&)
+		{
+			return true;
+		}
+	};
+
+	// Separating Axis Theorem for an N-gon against an M-gon, rotations are (cos, sin) of each angle
+	template<typename Real, int N, int M>
+	bool sat(const LinearAlgebra::Point<Real>* a, const LinearAlgebra::Point<Real>& aRotation,
+		const LinearAlgebra::Point<Real>* b, const LinearAlgebra::Point<Real>& bRotation, Real& minOverlap)
+	{
+		return AxesOf<Real, N, N, M>::overlap(aRotation, a, b, minOverlap) &&
+			AxesOf<Real, M, N, M>::overlap(bRotation, a, b, minOverlap);
+	}
+
+	template<typename Real>
+	using Kernel = bool (*)(const LinearAlgebra::Point<Real>*, const LinearAlgebra::Point<Real>&,
+		const LinearAlgebra::Point<Real>*, const LinearAlgebra::Point<Real>&, Real&);
+
+	// Kernel for an n-gon against an m-gon, nullptr outside MinCorners..MaxCorners
+	template<typename Real>
+	Kernel<Real> kernel(int n, int m);
+}
@@ -0,0 +1,233 @@
+#include "SimdKernels.h"
+#if defined(SIMD_X86)
+#include <immintrin.h>
+
+using Simd::PairBounds;
+using Simd::QuantizedBox;
+using Simd::ContactRows;
+using Simd::BodyVelocities;
+
+SIMD_TARGET("avx2")
+static int filterBoxes(const QuantizedBox* boxes, unsigned long long* pairs, int count)
+{	// Four pairs per step, each box gathered as one 64 bit lane, b's swapped to (max, min)
+	const __m256i indexMask = _mm256_set1_epi64x(0xFFFFFF);
+	const __m256i minHalf = _mm256_set1_epi64x(0x00000000FFFFFFFFll);
+	int kept = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i keys = _mm256_loadu_si256((const __m256i*)(pairs + i));
+		__m256i a = _mm256_i64gather_epi64((const long long*)boxes, _mm256_and_si256(_mm256_srli_epi64(keys, 24), indexMask), 8);
+		__m256i b = _mm256_i64gather_epi64((const long long*)boxes, _mm256_and_si256(keys, indexMask), 8);
+		__m256i swapped = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(b, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(1, 0, 3, 2));
+		__m256i apart = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi16(a, swapped), minHalf),
+			_mm256_andnot_si256(minHalf, _mm256_cmpgt_epi16(swapped, a)));
+
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(apart, _mm256_setzero_si256())));
+		for (int lane = 0; lane < 4; lane++) {
+			if (mask & (1 << lane))
+				pairs[kept++] = pairs[i + lane];
+		}
+	}
+	return Simd::filterBoxesTail(boxes, pairs, i, count, kept);
+}
+
+SIMD_TARGET("avx2")
+static int filterPairs(const PairBounds& bounds, unsigned long long* pairs, int count)
+{	// Four pairs per step, body indices decoded and gathered in vector registers
+	const __m256i indexMask = _mm256_set1_epi64x(0xFFFFFF);
+	int kept = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i keys = _mm256_loadu_si256((const __m256i*)(pairs + i));
+		__m256i a = _mm256_and_si256(_mm256_srli_epi64(keys, 24), indexMask);
+		__m256i b = _mm256_and_si256(keys, indexMask);
+
+		__m256d dx = _mm256_sub_pd(_mm256_i64gather_pd(bounds.x, a, 8), _mm256_i64gather_pd(bounds.x, b, 8));
+		__m256d dy = _mm256_sub_pd(_mm256_i64gather_pd(bounds.y, a, 8), _mm256_i64gather_pd(bounds.y, b, 8));
+		__m256d rSum = _mm256_add_pd(_mm256_i64gather_pd(bounds.radius, a, 8), _mm256_i64gather_pd(bounds.radius, b, 8));
+		__m256d distanceSquared = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+		__m256d hit = _mm256_cmp_pd(distanceSquared, _mm256_mul_pd(rSum, rSum), _CMP_LE_OQ);
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(_mm256_i64gather_pd(bounds.minX, a, 8), _mm256_i64gather_pd(bounds.maxX, b, 8), _CMP_LE_OQ));
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(_mm256_i64gather_pd(bounds.minX, b, 8), _mm256_i64gather_pd(bounds.maxX, a, 8), _CMP_LE_OQ));
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(_mm256_i64gather_pd(bounds.minY, a, 8), _mm256_i64gather_pd(bounds.maxY, b, 8), _CMP_LE_OQ));
+		hit = _mm256_and_pd(hit, _mm256_cmp_pd(_mm256_i64gather_pd(bounds.minY, b, 8), _mm256_i64gather_pd(bounds.maxY, a, 8), _CMP_LE_OQ));
+
+		int mask = _mm256_movemask_pd(hit);
+		for (int lane = 0; lane < 4; lane++) {
+			if (mask & (1 << lane))
+				pairs[kept++] = pairs[i + lane];
+		}
+	}
+	return Simd::filterPairsTail(bounds, pairs, i, count, kept);
+}
+
+SIMD_TARGET("avx2")
+static int filterWalls(const double* x, const double* y, const double* radius, int count,
+	double width, double height, int* bodies)
+{	// Four bodies per step, most steps find no body near a wall and write nothing
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d right = _mm256_set1_pd(width), bottom = _mm256_set1_pd(height);
+	int kept = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256d px = _mm256_loadu_pd(x + i);
+		__m256d py = _mm256_loadu_pd(y + i);
+		__m256d r = _mm256_loadu_pd(radius + i);
+		__m256d crossing = _mm256_or_pd(_mm256_cmp_pd(_mm256_sub_pd(px, r), zero, _CMP_LT_OQ),
+			_mm256_cmp_pd(_mm256_add_pd(px, r), right, _CMP_GT_OQ));
+		crossing = _mm256_or_pd(crossing, _mm256_cmp_pd(_mm256_sub_pd(py, r), zero, _CMP_LT_OQ));
+		crossing = _mm256_or_pd(crossing, _mm256_cmp_pd(_mm256_add_pd(py, r), bottom, _CMP_GT_OQ));
+
+		int mask = _mm256_movemask_pd(crossing);
+		for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+			if (mask & 1)
+				bodies[kept++] = i + lane;
+		}
+	}
+	return Simd::filterWallsTail(x, y, radius, i, count, width, height, bodies, kept);
+}
+
+SIMD_TARGET("avx2")
+static void transformCorners(const double* unitX, const double* unitY, int corners,
+	double x, double y, double radius, double cos, double sin, double* out)
+{
+	__m256d c = _mm256_set1_pd(cos), s = _mm256_set1_pd(sin), r = _mm256_set1_pd(radius);
+	__m256d px = _mm256_set1_pd(x), py = _mm256_set1_pd(y);
+	int i = 0;
+	for (; i + 4 <= corners; i += 4) {
+		__m256d ux = _mm256_loadu_pd(unitX + i);
+		__m256d uy = _mm256_loadu_pd(unitY + i);
+		__m256d cx = _mm256_add_pd(px, _mm256_mul_pd(r, _mm256_sub_pd(_mm256_mul_pd(ux, c), _mm256_mul_pd(uy, s))));
+		__m256d cy = _mm256_add_pd(py, _mm256_mul_pd(r, _mm256_add_pd(_mm256_mul_pd(ux, s), _mm256_mul_pd(uy, c))));
+		__m256d low = _mm256_unpacklo_pd(cx, cy);		// x0 y0 x2 y2
+		__m256d high = _mm256_unpackhi_pd(cx, cy);		// x1 y1 x3 y3
+		_mm256_storeu_pd(out + 2 * i, _mm256_permute2f128_pd(low, high, 0x20));
+		_mm256_storeu_pd(out + 2 * i + 4, _mm256_permute2f128_pd(low, high, 0x31));
+	}
+	Simd::transformCornersScalar(unitX + i, unitY + i, corners - i, x, y, radius, cos, sin, out + 2 * i);
+}
+
+SIMD_TARGET("avx2")
+static void transformCorners(const float* unitX, const float* unitY, int corners,
+	float x, float y, float radius, float cos, float sin, float* out)
+{
+	__m256 c = _mm256_set1_ps(cos), s = _mm256_set1_ps(sin), r = _mm256_set1_ps(radius);
+	__m256 px = _mm256_set1_ps(x), py = _mm256_set1_ps(y);
+	int i = 0;
+	for (; i + 8 <= corners; i += 8) {
+		__m256 ux = _mm256_loadu_ps(unitX + i);
+		__m256 uy = _mm256_loadu_ps(unitY + i);
+		__m256 cx = _mm256_add_ps(px, _mm256_mul_ps(r, _mm256_sub_ps(_mm256_mul_ps(ux, c), _mm256_mul_ps(uy, s))));
+		__m256 cy = _mm256_add_ps(py, _mm256_mul_ps(r, _mm256_add_ps(_mm256_mul_ps(ux, s), _mm256_mul_ps(uy, c))));
+		__m256 low = _mm256_unpacklo_ps(cx, cy);		// x0 y0 x1 y1 | x4 y4 x5 y5
+		__m256 high = _mm256_unpackhi_ps(cx, cy);		// x2 y2 x3 y3 | x6 y6 x7 y7
+		_mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+		_mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+	}
+	Simd::transformCornersScalar(unitX + i, unitY + i, corners - i, x, y, radius, cos, sin, out + 2 * i);
+}
+
+SIMD_TARGET("avx2")
+static void solveContactRows(const ContactRows<double>& rows, const BodyVelocities<double>& bodies, int first, int last,
+	double restitution)
+{	// Four contacts per step, velocities gathered by body index. AVX2 has no scatter, so they go back lane by lane.
+	const __m256d scale = _mm256_set1_pd(-(1 + restitution));
+	const __m256d zero = _mm256_setzero_pd();
+	int i = first;
+	for (; i + 4 <= last; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(rows.a + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(rows.b + i));
+		__m256d nx = _mm256_loadu_pd(rows.normalX + i);
+		__m256d ny = _mm256_loadu_pd(rows.normalY + i);
+		__m256d aRxN = _mm256_loadu_pd(rows.aRxN + i);
+		__m256d bRxN = _mm256_loadu_pd(rows.bRxN + i);
+		__m256d ax = _mm256_i32gather_pd(bodies.x, a, 8), ay = _mm256_i32gather_pd(bodies.y, a, 8), aw = _mm256_i32gather_pd(bodies.angle, a, 8);
+		__m256d bx = _mm256_i32gather_pd(bodies.x, b, 8), by = _mm256_i32gather_pd(bodies.y, b, 8), bw = _mm256_i32gather_pd(bodies.angle, b, 8);
+
+		__m256d approach = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(ax, bx), nx), _mm256_mul_pd(_mm256_sub_pd(ay, by), ny));
+		approach = _mm256_sub_pd(_mm256_add_pd(approach, _mm256_mul_pd(aw, aRxN)), _mm256_mul_pd(bw, bRxN));
+		__m256d impulse = _mm256_max_pd(zero, _mm256_mul_pd(_mm256_mul_pd(scale, approach), _mm256_loadu_pd(rows.normalMass + i)));
+		__m256d aImpulse = _mm256_mul_pd(impulse, _mm256_i32gather_pd(bodies.invMass, a, 8));
+		__m256d bImpulse = _mm256_mul_pd(impulse, _mm256_i32gather_pd(bodies.invMass, b, 8));
+
+		double out[6][4];
+		_mm256_storeu_pd(out[0], _mm256_add_pd(ax, _mm256_mul_pd(aImpulse, nx)));
+		_mm256_storeu_pd(out[1], _mm256_add_pd(ay, _mm256_mul_pd(aImpulse, ny)));
+		_mm256_storeu_pd(out[2], _mm256_add_pd(aw, _mm256_mul_pd(_mm256_mul_pd(impulse, _mm256_i32gather_pd(bodies.invInertia, a, 8)), aRxN)));
+		_mm256_storeu_pd(out[3], _mm256_sub_pd(bx, _mm256_mul_pd(bImpulse, nx)));
+		_mm256_storeu_pd(out[4], _mm256_sub_pd(by, _mm256_mul_pd(bImpulse, ny)));
+		_mm256_storeu_pd(out[5], _mm256_sub_pd(bw, _mm256_mul_pd(_mm256_mul_pd(impulse, _mm256_i32gather_pd(bodies.invInertia, b, 8)), bRxN)));
+		for (int lane = 0; lane < 4; lane++) {
+			int bodyA = rows.a[i + lane], bodyB = rows.b[i + lane];
+			bodies.x[bodyA] = out[0][lane];
+			bodies.y[bodyA] = out[1][lane];
+			bodies.angle[bodyA] = out[2][lane];
+			bodies.x[bodyB] = out[3][lane];
+			bodies.y[bodyB] = out[4][lane];
+			bodies.angle[bodyB] = out[5][lane];
+		}
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+SIMD_TARGET("avx2")
+static void solveContactRows(const ContactRows<float>& rows, const BodyVelocities<float>& bodies, int first, int last,
+	float restitution)
+{	// Eight contacts per step, otherwise the same as the double version
+	const __m256 scale = _mm256_set1_ps(-(1 + restitution));
+	const __m256 zero = _mm256_setzero_ps();
+	int i = first;
+	for (; i + 8 <= last; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(rows.a + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(rows.b + i));
+		__m256 nx = _mm256_loadu_ps(rows.normalX + i);
+		__m256 ny = _mm256_loadu_ps(rows.normalY + i);
+		__m256 aRxN = _mm256_loadu_ps(rows.aRxN + i);
+		__m256 bRxN = _mm256_loadu_ps(rows.bRxN + i);
+		__m256 ax = _mm256_i32gather_ps(bodies.x, a, 4), ay = _mm256_i32gather_ps(bodies.y, a, 4), aw = _mm256_i32gather_ps(bodies.angle, a, 4);
+		__m256 bx = _mm256_i32gather_ps(bodies.x, b, 4), by = _mm256_i32gather_ps(bodies.y, b, 4), bw = _mm256_i32gather_ps(bodies.angle, b, 4);
+
+		__m256 approach = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(ax, bx), nx), _mm256_mul_ps(_mm256_sub_ps(ay, by), ny));
+		approach = _mm256_sub_ps(_mm256_add_ps(approach, _mm256_mul_ps(aw, aRxN)), _mm256_mul_ps(bw, bRxN));
+		__m256 impulse = _mm256_max_ps(zero, _mm256_mul_ps(_mm256_mul_ps(scale, approach), _mm256_loadu_ps(rows.normalMass + i)));
+		__m256 aImpulse = _mm256_mul_ps(impulse, _mm256_i32gather_ps(bodies.invMass, a, 4));
+		__m256 bImpulse = _mm256_mul_ps(impulse, _mm256_i32gather_ps(bodies.invMass, b, 4));
+
+		float out[6][8];
+		_mm256_storeu_ps(out[0], _mm256_add_ps(ax, _mm256_mul_ps(aImpulse, nx)));
+		_mm256_storeu_ps(out[1], _mm256_add_ps(ay, _mm256_mul_ps(aImpulse, ny)));
+		_mm256_storeu_ps(out[2], _mm256_add_ps(aw, _mm256_mul_ps(_mm256_mul_ps(impulse, _mm256_i32gather_ps(bodies.invInertia, a, 4)), aRxN)));
+		_mm256_storeu_ps(out[3], _mm256_sub_ps(bx, _mm256_mul_ps(bImpulse, nx)));
+		_mm256_storeu_ps(out[4], _mm256_sub_ps(by, _mm256_mul_ps(bImpulse, ny)));
+		_mm256_storeu_ps(out[5], _mm256_sub_ps(bw, _mm256_mul_ps(_mm256_mul_ps(impulse, _mm256_i32gather_ps(bodies.invInertia, b, 4)), bRxN)));
+		for (int lane = 0; lane < 8; lane++) {
+			int bodyA = rows.a[i + lane], bodyB = rows.b[i + lane];
+			bodies.x[bodyA] = out[0][lane];
+			bodies.y[bodyA] = out[1][lane];
+			bodies.angle[bodyA] = out[2][lane];
+			bodies.x[bodyB] = out[3][lane];
+			bodies.y[bodyB] = out[4][lane];
+			bodies.angle[bodyB] = out[5][lane];
+		}
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+void Simd::loadAvx2(Kernels<float>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+
+void Simd::loadAvx2(Kernels<double>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+#endif
@@ -0,0 +1,227 @@
+#include "SimdKernels.h"
+#if defined(SIMD_X86)
+#include <immintrin.h>
+
+// AVX-512F brings FMA, which GCC would fuse the multiplies and adds into. Every tier keeps the scalar kernels' rounding.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+using Simd::PairBounds;
+using Simd::QuantizedBox;
+using Simd::ContactRows;
+using Simd::BodyVelocities;
+
+SIMD_TARGET("avx512f")
+static int filterBoxes(const QuantizedBox* boxes, unsigned long long* pairs, int count)
+{	// Eight pairs per step, box sides sign-extended out of their 64 bit lanes since AVX-512F has no 16 bit compares
+	const __m512i indexMask = _mm512_set1_epi64(0xFFFFFF);
+	int kept = 0;
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m512i keys = _mm512_loadu_si512(pairs + i);
+		__m512i a = _mm512_i64gather_epi64(_mm512_and_epi64(_mm512_srli_epi64(keys, 24), indexMask), boxes, 8);
+		__m512i b = _mm512_i64gather_epi64(_mm512_and_epi64(keys, indexMask), boxes, 8);
+
+		__mmask8 hit = _mm512_cmp_epi64_mask(_mm512_srai_epi64(_mm512_slli_epi64(a, 48), 48), _mm512_srai_epi64(_mm512_slli_epi64(b, 16), 48), _MM_CMPINT_LE);
+		hit = _mm512_mask_cmp_epi64_mask(hit, _mm512_srai_epi64(_mm512_slli_epi64(b, 48), 48), _mm512_srai_epi64(_mm512_slli_epi64(a, 16), 48), _MM_CMPINT_LE);
+		hit = _mm512_mask_cmp_epi64_mask(hit, _mm512_srai_epi64(_mm512_slli_epi64(a, 32), 48), _mm512_srai_epi64(b, 48), _MM_CMPINT_LE);
+		hit = _mm512_mask_cmp_epi64_mask(hit, _mm512_srai_epi64(_mm512_slli_epi64(b, 32), 48), _mm512_srai_epi64(a, 48), _MM_CMPINT_LE);
+
+		_mm512_mask_compressstoreu_epi64(pairs + kept, hit, keys);
+		for (unsigned int bits = hit; bits; bits &= bits - 1)
+			kept++;
+	}
+	return Simd::filterBoxesTail(boxes, pairs, i, count, kept);
+}
+
+SIMD_TARGET("avx512f")
+static int filterPairs(const PairBounds& bounds, unsigned long long* pairs, int count)
+{	// Eight pairs per step, box tests only gather for lanes still alive, survivors are compress-stored
+	const __m512i indexMask = _mm512_set1_epi64(0xFFFFFF);
+	int kept = 0;
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m512i keys = _mm512_loadu_si512(pairs + i);
+		__m512i a = _mm512_and_epi64(_mm512_srli_epi64(keys, 24), indexMask);
+		__m512i b = _mm512_and_epi64(keys, indexMask);
+
+		__m512d dx = _mm512_sub_pd(_mm512_i64gather_pd(a, bounds.x, 8), _mm512_i64gather_pd(b, bounds.x, 8));
+		__m512d dy = _mm512_sub_pd(_mm512_i64gather_pd(a, bounds.y, 8), _mm512_i64gather_pd(b, bounds.y, 8));
+		__m512d rSum = _mm512_add_pd(_mm512_i64gather_pd(a, bounds.radius, 8), _mm512_i64gather_pd(b, bounds.radius, 8));
+		__m512d distanceSquared = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+		__mmask8 hit = _mm512_cmp_pd_mask(distanceSquared, _mm512_mul_pd(rSum, rSum), _CMP_LE_OQ);
+
+		__m512d zero = _mm512_setzero_pd();
+		hit = _mm512_mask_cmp_pd_mask(hit, _mm512_mask_i64gather_pd(zero, hit, a, bounds.minX, 8), _mm512_mask_i64gather_pd(zero, hit, b, bounds.maxX, 8), _CMP_LE_OQ);
+		hit = _mm512_mask_cmp_pd_mask(hit, _mm512_mask_i64gather_pd(zero, hit, b, bounds.minX, 8), _mm512_mask_i64gather_pd(zero, hit, a, bounds.maxX, 8), _CMP_LE_OQ);
+		hit = _mm512_mask_cmp_pd_mask(hit, _mm512_mask_i64gather_pd(zero, hit, a, bounds.minY, 8), _mm512_mask_i64gather_pd(zero, hit, b, bounds.maxY, 8), _CMP_LE_OQ);
+		hit = _mm512_mask_cmp_pd_mask(hit, _mm512_mask_i64gather_pd(zero, hit, b, bounds.minY, 8), _mm512_mask_i64gather_pd(zero, hit, a, bounds.maxY, 8), _CMP_LE_OQ);
+
+		_mm512_mask_compressstoreu_epi64(pairs + kept, hit, keys);
+		for (unsigned int bits = hit; bits; bits &= bits - 1)
+			kept++;
+	}
+	return Simd::filterPairsTail(bounds, pairs, i, count, kept);
+}
+
+SIMD_TARGET("avx512f")
+static int filterWalls(const double* x, const double* y, const double* radius, int count,
+	double width, double height, int* bodies)
+{	// Eight bodies per step, indices of the crossing ones compress-stored
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d right = _mm512_set1_pd(width), bottom = _mm512_set1_pd(height);
+	const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	int kept = 0;
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m512d px = _mm512_loadu_pd(x + i);
+		__m512d py = _mm512_loadu_pd(y + i);
+		__m512d r = _mm512_loadu_pd(radius + i);
+		__mmask8 crossing = _mm512_cmp_pd_mask(_mm512_sub_pd(px, r), zero, _CMP_LT_OQ) |
+			_mm512_cmp_pd_mask(_mm512_add_pd(px, r), right, _CMP_GT_OQ) |
+			_mm512_cmp_pd_mask(_mm512_sub_pd(py, r), zero, _CMP_LT_OQ) |
+			_mm512_cmp_pd_mask(_mm512_add_pd(py, r), bottom, _CMP_GT_OQ);
+		if (crossing == 0)
+			continue;
+
+		_mm512_mask_compressstoreu_epi32(bodies + kept, crossing, _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+		for (unsigned int bits = crossing; bits; bits &= bits - 1)
+			kept++;
+	}
+	return Simd::filterWallsTail(x, y, radius, i, count, width, height, bodies, kept);
+}
+
+SIMD_TARGET("avx512f")
+static void transformCorners(const double* unitX, const double* unitY, int corners,
+	double x, double y, double radius, double cos, double sin, double* out)
+{	// Up to eight corners per step, the last step masked
+	const __m512i lowOrder = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);		// x0 y0 .. x3 y3
+	const __m512i highOrder = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);	// x4 y4 .. x7 y7
+	__m512d c = _mm512_set1_pd(cos), s = _mm512_set1_pd(sin), r = _mm512_set1_pd(radius);
+	__m512d px = _mm512_set1_pd(x), py = _mm512_set1_pd(y);
+	for (int i = 0; i < corners; i += 8) {
+		int lanes = corners - i < 8 ? corners - i : 8;
+		__mmask8 load = (__mmask8)((1u << lanes) - 1);
+		__m512d ux = _mm512_maskz_loadu_pd(load, unitX + i);
+		__m512d uy = _mm512_maskz_loadu_pd(load, unitY + i);
+		__m512d cx = _mm512_add_pd(px, _mm512_mul_pd(r, _mm512_sub_pd(_mm512_mul_pd(ux, c), _mm512_mul_pd(uy, s))));
+		__m512d cy = _mm512_add_pd(py, _mm512_mul_pd(r, _mm512_add_pd(_mm512_mul_pd(ux, s), _mm512_mul_pd(uy, c))));
+
+		int values = 2 * lanes;
+		__mmask8 lowStore = (__mmask8)(values >= 8 ? 0xFF : (1u << values) - 1);
+		__mmask8 highStore = (__mmask8)(values > 8 ? (1u << (values - 8)) - 1 : 0);
+		_mm512_mask_storeu_pd(out + 2 * i, lowStore, _mm512_permutex2var_pd(cx, lowOrder, cy));
+		_mm512_mask_storeu_pd(out + 2 * i + 8, highStore, _mm512_permutex2var_pd(cx, highOrder, cy));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void transformCorners(const float* unitX, const float* unitY, int corners,
+	float x, float y, float radius, float cos, float sin, float* out)
+{	// Up to sixteen corners per step, the last step masked
+	const __m512i lowOrder = _mm512_set_epi32(23, 7, 22, 6, 21, 5, 20, 4, 19, 3, 18, 2, 17, 1, 16, 0);
+	const __m512i highOrder = _mm512_set_epi32(31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25, 9, 24, 8);
+	__m512 c = _mm512_set1_ps(cos), s = _mm512_set1_ps(sin), r = _mm512_set1_ps(radius);
+	__m512 px = _mm512_set1_ps(x), py = _mm512_set1_ps(y);
+	for (int i = 0; i < corners; i += 16) {
+		int lanes = corners - i < 16 ? corners - i : 16;
+		__mmask16 load = (__mmask16)((1u << lanes) - 1);
+		__m512 ux = _mm512_maskz_loadu_ps(load, unitX + i);
+		__m512 uy = _mm512_maskz_loadu_ps(load, unitY + i);
+		__m512 cx = _mm512_add_ps(px, _mm512_mul_ps(r, _mm512_sub_ps(_mm512_mul_ps(ux, c), _mm512_mul_ps(uy, s))));
+		__m512 cy = _mm512_add_ps(py, _mm512_mul_ps(r, _mm512_add_ps(_mm512_mul_ps(ux, s), _mm512_mul_ps(uy, c))));
+
+		int values = 2 * lanes;
+		__mmask16 lowStore = (__mmask16)(values >= 16 ? 0xFFFF : (1u << values) - 1);
+		__mmask16 highStore = (__mmask16)(values > 16 ? (1u << (values - 16)) - 1 : 0);
+		_mm512_mask_storeu_ps(out + 2 * i, lowStore, _mm512_permutex2var_ps(cx, lowOrder, cy));
+		_mm512_mask_storeu_ps(out + 2 * i + 16, highStore, _mm512_permutex2var_ps(cx, highOrder, cy));
+	}
+}
+
+SIMD_TARGET("avx512f")
+static void solveContactRows(const ContactRows<double>& rows, const BodyVelocities<double>& bodies, int first, int last,
+	double restitution)
+{	// Eight contacts per step, one colour row. Velocities are gathered and scattered by body index,
+	// lanes never share a body, so the scatters cannot collide (padding lanes all write the spare body unchanged).
+	const __m512d scale = _mm512_set1_pd(-(1 + restitution));
+	const __m512d zero = _mm512_setzero_pd();
+	int i = first;
+	for (; i + 8 <= last; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(rows.a + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(rows.b + i));
+		__m512d nx = _mm512_loadu_pd(rows.normalX + i);
+		__m512d ny = _mm512_loadu_pd(rows.normalY + i);
+		__m512d aRxN = _mm512_loadu_pd(rows.aRxN + i);
+		__m512d bRxN = _mm512_loadu_pd(rows.bRxN + i);
+		__m512d ax = _mm512_i32gather_pd(a, bodies.x, 8), ay = _mm512_i32gather_pd(a, bodies.y, 8), aw = _mm512_i32gather_pd(a, bodies.angle, 8);
+		__m512d bx = _mm512_i32gather_pd(b, bodies.x, 8), by = _mm512_i32gather_pd(b, bodies.y, 8), bw = _mm512_i32gather_pd(b, bodies.angle, 8);
+
+		__m512d approach = _mm512_add_pd(_mm512_mul_pd(_mm512_sub_pd(ax, bx), nx), _mm512_mul_pd(_mm512_sub_pd(ay, by), ny));
+		approach = _mm512_sub_pd(_mm512_add_pd(approach, _mm512_mul_pd(aw, aRxN)), _mm512_mul_pd(bw, bRxN));
+		__m512d impulse = _mm512_max_pd(zero, _mm512_mul_pd(_mm512_mul_pd(scale, approach), _mm512_loadu_pd(rows.normalMass + i)));
+		__m512d aImpulse = _mm512_mul_pd(impulse, _mm512_i32gather_pd(a, bodies.invMass, 8));
+		__m512d bImpulse = _mm512_mul_pd(impulse, _mm512_i32gather_pd(b, bodies.invMass, 8));
+
+		_mm512_i32scatter_pd(bodies.x, a, _mm512_add_pd(ax, _mm512_mul_pd(aImpulse, nx)), 8);
+		_mm512_i32scatter_pd(bodies.y, a, _mm512_add_pd(ay, _mm512_mul_pd(aImpulse, ny)), 8);
+		_mm512_i32scatter_pd(bodies.angle, a, _mm512_add_pd(aw, _mm512_mul_pd(_mm512_mul_pd(impulse, _mm512_i32gather_pd(a, bodies.invInertia, 8)), aRxN)), 8);
+		_mm512_i32scatter_pd(bodies.x, b, _mm512_sub_pd(bx, _mm512_mul_pd(bImpulse, nx)), 8);
+		_mm512_i32scatter_pd(bodies.y, b, _mm512_sub_pd(by, _mm512_mul_pd(bImpulse, ny)), 8);
+		_mm512_i32scatter_pd(bodies.angle, b, _mm512_sub_pd(bw, _mm512_mul_pd(_mm512_mul_pd(impulse, _mm512_i32gather_pd(b, bodies.invInertia, 8)), bRxN)), 8);
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+SIMD_TARGET("avx512f")
+static void solveContactRows(const ContactRows<float>& rows, const BodyVelocities<float>& bodies, int first, int last,
+	float restitution)
+{	// Sixteen contacts per step, two padded rows of one colour
+	const __m512 scale = _mm512_set1_ps(-(1 + restitution));
+	const __m512 zero = _mm512_setzero_ps();
+	int i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m512i a = _mm512_loadu_si512(rows.a + i);
+		__m512i b = _mm512_loadu_si512(rows.b + i);
+		__m512 nx = _mm512_loadu_ps(rows.normalX + i);
+		__m512 ny = _mm512_loadu_ps(rows.normalY + i);
+		__m512 aRxN = _mm512_loadu_ps(rows.aRxN + i);
+		__m512 bRxN = _mm512_loadu_ps(rows.bRxN + i);
+		__m512 ax = _mm512_i32gather_ps(a, bodies.x, 4), ay = _mm512_i32gather_ps(a, bodies.y, 4), aw = _mm512_i32gather_ps(a, bodies.angle, 4);
+		__m512 bx = _mm512_i32gather_ps(b, bodies.x, 4), by = _mm512_i32gather_ps(b, bodies.y, 4), bw = _mm512_i32gather_ps(b, bodies.angle, 4);
+
+		__m512 approach = _mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(ax, bx), nx), _mm512_mul_ps(_mm512_sub_ps(ay, by), ny));
+		approach = _mm512_sub_ps(_mm512_add_ps(approach, _mm512_mul_ps(aw, aRxN)), _mm512_mul_ps(bw, bRxN));
+		__m512 impulse = _mm512_max_ps(zero, _mm512_mul_ps(_mm512_mul_ps(scale, approach), _mm512_loadu_ps(rows.normalMass + i)));
+		__m512 aImpulse = _mm512_mul_ps(impulse, _mm512_i32gather_ps(a, bodies.invMass, 4));
+		__m512 bImpulse = _mm512_mul_ps(impulse, _mm512_i32gather_ps(b, bodies.invMass, 4));
+
+		_mm512_i32scatter_ps(bodies.x, a, _mm512_add_ps(ax, _mm512_mul_ps(aImpulse, nx)), 4);
+		_mm512_i32scatter_ps(bodies.y, a, _mm512_add_ps(ay, _mm512_mul_ps(aImpulse, ny)), 4);
+		_mm512_i32scatter_ps(bodies.angle, a, _mm512_add_ps(aw, _mm512_mul_ps(_mm512_mul_ps(impulse, _mm512_i32gather_ps(a, bodies.invInertia, 4)), aRxN)), 4);
+		_mm512_i32scatter_ps(bodies.x, b, _mm512_sub_ps(bx, _mm512_mul_ps(bImpulse, nx)), 4);
+		_mm512_i32scatter_ps(bodies.y, b, _mm512_sub_ps(by, _mm512_mul_ps(bImpulse, ny)), 4);
+		_mm512_i32scatter_ps(bodies.angle, b, _mm512_sub_ps(bw, _mm512_mul_ps(_mm512_mul_ps(impulse, _mm512_i32gather_ps(b, bodies.invInertia, 4)), bRxN)), 4);
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+void Simd::loadAvx512(Kernels<float>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+
+void Simd::loadAvx512(Kernels<double>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+#endif
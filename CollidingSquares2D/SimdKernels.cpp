@@ -0,0 +1,249 @@
+#include "SimdKernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(SIMD_X86)
+#include <cpuid.h>
+#endif
+
+#if defined(SIMD_X86)
+static void cpuid(int leaf, int subleaf, unsigned int info[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex((int*)info, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static unsigned long long enabledStateComponents()
+{	// XCR0, which register states the OS saves on context switches
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return (unsigned long long)high << 32 | low;
+#endif
+}
+#endif
+
+static bool overrideName(char* name, int size)
+{	// COLLISION_SIMD from the environment, false when unset
+#if defined(_MSC_VER)
+	char* value = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&value, &length, "COLLISION_SIMD") != 0 || value == nullptr)
+		return false;
+	strncpy_s(name, size, value, _TRUNCATE);
+	free(value);
+#else
+	const char* value = getenv("COLLISION_SIMD");
+	if (value == nullptr)
+		return false;
+	strncpy(name, value, size - 1);
+	name[size - 1] = 0;
+#endif
+	return true;
+}
+
+Simd::Tier Simd::detectedTier()
+{
+#if defined(SIMD_X86)
+	unsigned int info[4];
+	cpuid(0, 0, info);
+	unsigned int maxLeaf = info[0];
+
+	cpuid(1, 0, info);
+	if (!(info[3] & (1u << 26)))
+		return Scalar;
+	bool osSavesYmm = (info[2] & (1u << 27)) && (info[2] & (1u << 28)) && (enabledStateComponents() & 0x06) == 0x06;
+	if (!osSavesYmm || maxLeaf < 7)
+		return SSE2;
+
+	cpuid(7, 0, info);
+	if (!(info[1] & (1u << 5)))
+		return SSE2;
+	bool osSavesZmm = (enabledStateComponents() & 0xE6) == 0xE6;
+	if (!osSavesZmm || !(info[1] & (1u << 16)))
+		return AVX2;
+	return AVX512;
+#else
+	return Scalar;
+#endif
+}
+
+Simd::Tier Simd::activeTier()
+{	// An override can only lower the tier, never pick one the CPU lacks
+	Tier tier = detectedTier();
+	char name[16];
+	if (!overrideName(name, sizeof(name)))
+		return tier;
+
+	for (int candidate = Scalar; candidate <= AVX512; candidate++) {
+		if (strcmp(name, tierName((Tier)candidate)) == 0)
+			return candidate < tier ? (Tier)candidate : tier;
+	}
+	return tier;
+}
+
+const char* Simd::tierName(Tier tier)
+{
+	switch (tier)
+	{
+	case SSE2:
+		return "sse2";
+	case AVX2:
+		return "avx2";
+	case AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+template<typename Real>
+const Simd::Kernels<Real>& Simd::kernels()
+{
+	static const Kernels<Real> selected = [] {
+		Kernels<Real> kernels;
+		switch (activeTier())
+		{
+#if defined(SIMD_X86)
+		case AVX512:
+			loadAvx512(kernels);
+			break;
+		case AVX2:
+			loadAvx2(kernels);
+			break;
+		case SSE2:
+			loadSse2(kernels);
+			break;
+#endif
+		default:
+			loadScalar(kernels);
+			break;
+		}
+		return kernels;
+	}();
+	return selected;
+}
+
+int Simd::filterBoxesTail(const QuantizedBox* boxes, unsigned long long* pairs, int first, int count, int kept)
+{
+	for (int i = first; i < count; i++) {
+		auto& a = boxes[(pairs[i] >> 24) & 0xFFFFFF];
+		auto& b = boxes[pairs[i] & 0xFFFFFF];
+		if (a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY)
+			pairs[kept++] = pairs[i];
+	}
+	return kept;
+}
+
+static int filterBoxesScalar(const Simd::QuantizedBox* boxes, unsigned long long* pairs, int count)
+{
+	return Simd::filterBoxesTail(boxes, pairs, 0, count, 0);
+}
+
+int Simd::filterPairsTail(const PairBounds& bounds, unsigned long long* pairs, int first, int count, int kept)
+{
+	for (int i = first; i < count; i++) {
+		int a = (pairs[i] >> 24) & 0xFFFFFF;
+		int b = pairs[i] & 0xFFFFFF;
+		double dx = bounds.x[a] - bounds.x[b];
+		double dy = bounds.y[a] - bounds.y[b];
+		double rSum = bounds.radius[a] + bounds.radius[b];
+		bool hit = dx * dx + dy * dy <= rSum * rSum &&
+			bounds.minX[a] <= bounds.maxX[b] && bounds.minX[b] <= bounds.maxX[a] &&
+			bounds.minY[a] <= bounds.maxY[b] && bounds.minY[b] <= bounds.maxY[a];
+		if (hit)
+			pairs[kept++] = pairs[i];
+	}
+	return kept;
+}
+
+static int filterPairsScalar(const Simd::PairBounds& bounds, unsigned long long* pairs, int count)
+{
+	return Simd::filterPairsTail(bounds, pairs, 0, count, 0);
+}
+
+int Simd::filterWallsTail(const double* x, const double* y, const double* radius, int first, int count,
+	double width, double height, int* bodies, int kept)
+{
+	for (int i = first; i < count; i++) {
+		if (x[i] - radius[i] < 0 || x[i] + radius[i] > width || y[i] - radius[i] < 0 || y[i] + radius[i] > height)
+			bodies[kept++] = i;
+	}
+	return kept;
+}
+
+static int filterWallsScalar(const double* x, const double* y, const double* radius, int count,
+	double width, double height, int* bodies)
+{
+	return Simd::filterWallsTail(x, y, radius, 0, count, width, height, bodies, 0);
+}
+
+template<typename Real>
+void Simd::transformCornersScalar(const Real* unitX, const Real* unitY, int corners,
+	Real x, Real y, Real radius, Real cos, Real sin, Real* out)
+{
+	for (int i = 0; i < corners; i++) {
+		out[2 * i] = x + radius * (unitX[i] * cos - unitY[i] * sin);
+		out[2 * i + 1] = y + radius * (unitX[i] * sin + unitY[i] * cos);
+	}
+}
+
+template<typename Real>
+void Simd::solveContactRowsTail(const ContactRows<Real>& rows, const BodyVelocities<Real>& bodies,
+	int first, int last, Real restitution)
+{	// Same operations in the same order as every wider tier's lanes
+	for (int i = first; i < last; i++) {
+		int a = rows.a[i];
+		int b = rows.b[i];
+		Real approach = (bodies.x[a] - bodies.x[b]) * rows.normalX[i] + (bodies.y[a] - bodies.y[b]) * rows.normalY[i]
+			+ bodies.angle[a] * rows.aRxN[i] - bodies.angle[b] * rows.bRxN[i];
+		Real impulse = std::max(-(1 + restitution) * approach * rows.normalMass[i], Real(0));
+		Real aImpulse = impulse * bodies.invMass[a];
+		Real bImpulse = impulse * bodies.invMass[b];
+		bodies.x[a] = bodies.x[a] + aImpulse * rows.normalX[i];
+		bodies.y[a] = bodies.y[a] + aImpulse * rows.normalY[i];
+		bodies.angle[a] = bodies.angle[a] + impulse * bodies.invInertia[a] * rows.aRxN[i];
+		bodies.x[b] = bodies.x[b] - bImpulse * rows.normalX[i];
+		bodies.y[b] = bodies.y[b] - bImpulse * rows.normalY[i];
+		bodies.angle[b] = bodies.angle[b] - impulse * bodies.invInertia[b] * rows.bRxN[i];
+	}
+}
+
+template<typename Real>
+static void solveContactRowsScalar(const Simd::ContactRows<Real>& rows, const Simd::BodyVelocities<Real>& bodies,
+	int first, int last, Real restitution)
+{
+	Simd::solveContactRowsTail(rows, bodies, first, last, restitution);
+}
+
+void Simd::loadScalar(Kernels<float>& kernels)
+{
+	kernels.filterBoxes = &filterBoxesScalar;
+	kernels.filterPairs = &filterPairsScalar;
+	kernels.filterWalls = &filterWallsScalar;
+	kernels.transformCorners = &transformCornersScalar<float>;
+	kernels.solveContactRows = &solveContactRowsScalar<float>;
+}
+
+void Simd::loadScalar(Kernels<double>& kernels)
+{
+	kernels.filterBoxes = &filterBoxesScalar;
+	kernels.filterPairs = &filterPairsScalar;
+	kernels.filterWalls = &filterWallsScalar;
+	kernels.transformCorners = &transformCornersScalar<double>;
+	kernels.solveContactRows = &solveContactRowsScalar<double>;
+}
+
+template const Simd::Kernels<float>& Simd::kernels<float>();
+template const Simd::Kernels<double>& Simd::kernels<double>();
+template void Simd::transformCornersScalar(const float*, const float*, int, float, float, float, float, float, float*);
+template void Simd::transformCornersScalar(const double*, const double*, int, double, double, double, double, double, double*);
+template void Simd::solveContactRowsTail(const ContactRows<float>&, const BodyVelocities<float>&, int, int, float);
+template void Simd::solveContactRowsTail(const ContactRows<double>&, const BodyVelocities<double>&, int, int, double);
@@ -0,0 +1,110 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#endif
+
+// MSVC builds each wider tier's file for that tier, GCC and Clang target the kernels function by function
+#if defined(__GNUC__)
+#define SIMD_TARGET(features) __attribute__((target(features)))
+#else
+#define SIMD_TARGET(features)
+#endif
+
+namespace Simd {
+
+	// Instruction set tiers, each tier's kernels live in their own translation unit built for it
+	enum Tier {
+		Scalar,
+		SSE2,
+		AVX2,
+		AVX512
+	};
+
+	// Per body bounding circles and boxes, as separate arrays
+	struct PairBounds {
+		const double* x;
+		const double* y;
+		const double* radius;
+		const double* minX;
+		const double* minY;
+		const double* maxX;
+		const double* maxY;
+	};
+
+	// Bounding box quantized to 16 bits over the world's extent, rounded outward
+	struct QuantizedBox {
+		short minX;
+		short minY;
+		short maxX;
+		short maxY;
+	};
+
+	// One contact per entry, as separate arrays. Padding entries point a and b at a spare body and have zero normalMass.
+	template<typename Real>
+	struct ContactRows {
+		const int* a;
+		const int* b;
+		const Real* normalX;		// From b towards a
+		const Real* normalY;
+		const Real* aRxN;			// Lever arm of each body crossed with the normal
+		const Real* bRxN;
+		const Real* normalMass;		// 1 / effective mass along the normal
+	};
+
+	// Body velocities gathered for the contact solver, as separate arrays
+	template<typename Real>
+	struct BodyVelocities {
+		Real* x;
+		Real* y;
+		Real* angle;
+		const Real* invMass;
+		const Real* invInertia;
+	};
+
+	template<typename Real>
+	struct Kernels {
+		// Integer overlap test of quantized boxes, same pair layout and compaction as filterPairs
+		int (*filterBoxes)(const QuantizedBox* boxes, unsigned long long* pairs, int count);
+		// Bounding circle and box test over pair keys holding body indices in bits 24-47 and 0-23.
+		// Survivors are compacted to the front, returns how many there are.
+		int (*filterPairs)(const PairBounds& bounds, unsigned long long* pairs, int count);
+		// Bodies whose bounding circle reaches past 0 or width in x, 0 or height in y.
+		// Their indices are written to bodies, returns how many there are.
+		int (*filterWalls)(const double* x, const double* y, const double* radius, int count,
+			double width, double height, int* bodies);
+		// Corners of a regular polygon, position + radius * unit corners rotated by (cos, sin), written as x, y pairs
+		void (*transformCorners)(const Real* unitX, const Real* unitY, int corners,
+			Real x, Real y, Real radius, Real cos, Real sin, Real* out);
+		// Velocity impulse of contacts first to last, no two of which share a body. Approaching contacts get
+		// -(1 + restitution) * approach * normalMass, the rest none.
+		void (*solveContactRows)(const ContactRows<Real>& rows, const BodyVelocities<Real>& bodies, int first, int last,
+			Real restitution);
+	};
+
+	Tier detectedTier();		// Best tier this CPU and OS support
+	Tier activeTier();			// Detected tier, lowered by COLLISION_SIMD=scalar|sse2|avx2|avx512
+	const char* tierName(Tier tier);
+	template<typename Real> const Kernels<Real>& kernels();	// Picked once, on first use
+
+	// Scalar kernels, the wider tiers also finish their tails with them
+	int filterBoxesTail(const QuantizedBox* boxes, unsigned long long* pairs, int first, int count, int kept);
+	int filterPairsTail(const PairBounds& bounds, unsigned long long* pairs, int first, int count, int kept);
+	int filterWallsTail(const double* x, const double* y, const double* radius, int first, int count,
+		double width, double height, int* bodies, int kept);
+	template<typename Real> void transformCornersScalar(const Real* unitX, const Real* unitY, int corners,
+		Real x, Real y, Real radius, Real cos, Real sin, Real* out);
+	template<typename Real> void solveContactRowsTail(const ContactRows<Real>& rows, const BodyVelocities<Real>& bodies,
+		int first, int last, Real restitution);
+
+	void loadScalar(Kernels<float>& kernels);
+	void loadScalar(Kernels<double>& kernels);
+#if defined(SIMD_X86)
+	void loadSse2(Kernels<float>& kernels);
+	void loadSse2(Kernels<double>& kernels);
+	void loadAvx2(Kernels<float>& kernels);
+	void loadAvx2(Kernels<double>& kernels);
+	void loadAvx512(Kernels<float>& kernels);
+	void loadAvx512(Kernels<double>& kernels);
+#endif
+}
@@ -0,0 +1,230 @@
+#include "SimdKernels.h"
+#if defined(SIMD_X86)
+#include <emmintrin.h>
+
+using Simd::PairBounds;
+using Simd::QuantizedBox;
+using Simd::ContactRows;
+using Simd::BodyVelocities;
+
+static int filterBoxes(const QuantizedBox* boxes, unsigned long long* pairs, int count)
+{	// Two pairs per step, b's box swapped to (max, min) so one signed compare per direction covers all four sides
+	const __m128i minHalf = _mm_set_epi16(0, 0, -1, -1, 0, 0, -1, -1);
+	int kept = 0;
+	int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		auto box = [&](int pair, int shift) {
+			return _mm_loadl_epi64((const __m128i*)(boxes + ((pairs[i + pair] >> shift) & 0xFFFFFF)));
+		};
+		__m128i a = _mm_unpacklo_epi64(box(0, 24), box(1, 24));
+		__m128i b = _mm_unpacklo_epi64(box(0, 0), box(1, 0));
+		__m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(1, 0, 3, 2));
+		__m128i apart = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi16(a, swapped), minHalf),
+			_mm_andnot_si128(minHalf, _mm_cmpgt_epi16(swapped, a)));
+
+		int mask = _mm_movemask_epi8(apart);
+		if ((mask & 0x00FF) == 0)
+			pairs[kept++] = pairs[i];
+		if ((mask & 0xFF00) == 0)
+			pairs[kept++] = pairs[i + 1];
+	}
+	return Simd::filterBoxesTail(boxes, pairs, i, count, kept);
+}
+
+static int filterPairs(const PairBounds& bounds, unsigned long long* pairs, int count)
+{	// Two pairs per step, body data gathered lane by lane
+	int kept = 0;
+	int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		int a[2], b[2];
+		for (int lane = 0; lane < 2; lane++) {
+			a[lane] = (pairs[i + lane] >> 24) & 0xFFFFFF;
+			b[lane] = pairs[i + lane] & 0xFFFFFF;
+		}
+		auto gather = [&](const double* v, const int* index) {
+			return _mm_set_pd(v[index[1]], v[index[0]]);
+		};
+
+		__m128d dx = _mm_sub_pd(gather(bounds.x, a), gather(bounds.x, b));
+		__m128d dy = _mm_sub_pd(gather(bounds.y, a), gather(bounds.y, b));
+		__m128d rSum = _mm_add_pd(gather(bounds.radius, a), gather(bounds.radius, b));
+		__m128d distanceSquared = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+		__m128d hit = _mm_cmple_pd(distanceSquared, _mm_mul_pd(rSum, rSum));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(gather(bounds.minX, a), gather(bounds.maxX, b)));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(gather(bounds.minX, b), gather(bounds.maxX, a)));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(gather(bounds.minY, a), gather(bounds.maxY, b)));
+		hit = _mm_and_pd(hit, _mm_cmple_pd(gather(bounds.minY, b), gather(bounds.maxY, a)));
+
+		int mask = _mm_movemask_pd(hit);
+		for (int lane = 0; lane < 2; lane++) {
+			if (mask & (1 << lane))
+				pairs[kept++] = pairs[i + lane];
+		}
+	}
+	return Simd::filterPairsTail(bounds, pairs, i, count, kept);
+}
+
+static int filterWalls(const double* x, const double* y, const double* radius, int count,
+	double width, double height, int* bodies)
+{	// Two bodies per step, all four walls in one mask
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d right = _mm_set1_pd(width), bottom = _mm_set1_pd(height);
+	int kept = 0;
+	int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128d px = _mm_loadu_pd(x + i);
+		__m128d py = _mm_loadu_pd(y + i);
+		__m128d r = _mm_loadu_pd(radius + i);
+		__m128d crossing = _mm_or_pd(_mm_cmplt_pd(_mm_sub_pd(px, r), zero), _mm_cmpgt_pd(_mm_add_pd(px, r), right));
+		crossing = _mm_or_pd(crossing, _mm_cmplt_pd(_mm_sub_pd(py, r), zero));
+		crossing = _mm_or_pd(crossing, _mm_cmpgt_pd(_mm_add_pd(py, r), bottom));
+
+		int mask = _mm_movemask_pd(crossing);
+		for (int lane = 0; lane < 2; lane++) {
+			if (mask & (1 << lane))
+				bodies[kept++] = i + lane;
+		}
+	}
+	return Simd::filterWallsTail(x, y, radius, i, count, width, height, bodies, kept);
+}
+
+static void transformCorners(const double* unitX, const double* unitY, int corners,
+	double x, double y, double radius, double cos, double sin, double* out)
+{
+	__m128d c = _mm_set1_pd(cos), s = _mm_set1_pd(sin), r = _mm_set1_pd(radius);
+	__m128d px = _mm_set1_pd(x), py = _mm_set1_pd(y);
+	int i = 0;
+	for (; i + 2 <= corners; i += 2) {
+		__m128d ux = _mm_loadu_pd(unitX + i);
+		__m128d uy = _mm_loadu_pd(unitY + i);
+		__m128d cx = _mm_add_pd(px, _mm_mul_pd(r, _mm_sub_pd(_mm_mul_pd(ux, c), _mm_mul_pd(uy, s))));
+		__m128d cy = _mm_add_pd(py, _mm_mul_pd(r, _mm_add_pd(_mm_mul_pd(ux, s), _mm_mul_pd(uy, c))));
+		_mm_storeu_pd(out + 2 * i, _mm_unpacklo_pd(cx, cy));
+		_mm_storeu_pd(out + 2 * i + 2, _mm_unpackhi_pd(cx, cy));
+	}
+	Simd::transformCornersScalar(unitX + i, unitY + i, corners - i, x, y, radius, cos, sin, out + 2 * i);
+}
+
+static void transformCorners(const float* unitX, const float* unitY, int corners,
+	float x, float y, float radius, float cos, float sin, float* out)
+{
+	__m128 c = _mm_set1_ps(cos), s = _mm_set1_ps(sin), r = _mm_set1_ps(radius);
+	__m128 px = _mm_set1_ps(x), py = _mm_set1_ps(y);
+	int i = 0;
+	for (; i + 4 <= corners; i += 4) {
+		__m128 ux = _mm_loadu_ps(unitX + i);
+		__m128 uy = _mm_loadu_ps(unitY + i);
+		__m128 cx = _mm_add_ps(px, _mm_mul_ps(r, _mm_sub_ps(_mm_mul_ps(ux, c), _mm_mul_ps(uy, s))));
+		__m128 cy = _mm_add_ps(py, _mm_mul_ps(r, _mm_add_ps(_mm_mul_ps(ux, s), _mm_mul_ps(uy, c))));
+		_mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(cx, cy));
+		_mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(cx, cy));
+	}
+	Simd::transformCornersScalar(unitX + i, unitY + i, corners - i, x, y, radius, cos, sin, out + 2 * i);
+}
+
+static void solveContactRows(const ContactRows<double>& rows, const BodyVelocities<double>& bodies, int first, int last,
+	double restitution)
+{	// Two contacts per step, velocities gathered and written back lane by lane
+	const __m128d scale = _mm_set1_pd(-(1 + restitution));
+	const __m128d zero = _mm_setzero_pd();
+	int i = first;
+	for (; i + 2 <= last; i += 2) {
+		const int* a = rows.a + i;
+		const int* b = rows.b + i;
+		auto gather = [&](const double* v, const int* index) {
+			return _mm_set_pd(v[index[1]], v[index[0]]);
+		};
+		__m128d nx = _mm_loadu_pd(rows.normalX + i);
+		__m128d ny = _mm_loadu_pd(rows.normalY + i);
+		__m128d aRxN = _mm_loadu_pd(rows.aRxN + i);
+		__m128d bRxN = _mm_loadu_pd(rows.bRxN + i);
+		__m128d ax = gather(bodies.x, a), ay = gather(bodies.y, a), aw = gather(bodies.angle, a);
+		__m128d bx = gather(bodies.x, b), by = gather(bodies.y, b), bw = gather(bodies.angle, b);
+
+		__m128d approach = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(ax, bx), nx), _mm_mul_pd(_mm_sub_pd(ay, by), ny));
+		approach = _mm_sub_pd(_mm_add_pd(approach, _mm_mul_pd(aw, aRxN)), _mm_mul_pd(bw, bRxN));
+		__m128d impulse = _mm_max_pd(zero, _mm_mul_pd(_mm_mul_pd(scale, approach), _mm_loadu_pd(rows.normalMass + i)));
+		__m128d aImpulse = _mm_mul_pd(impulse, gather(bodies.invMass, a));
+		__m128d bImpulse = _mm_mul_pd(impulse, gather(bodies.invMass, b));
+
+		double out[6][2];
+		_mm_storeu_pd(out[0], _mm_add_pd(ax, _mm_mul_pd(aImpulse, nx)));
+		_mm_storeu_pd(out[1], _mm_add_pd(ay, _mm_mul_pd(aImpulse, ny)));
+		_mm_storeu_pd(out[2], _mm_add_pd(aw, _mm_mul_pd(_mm_mul_pd(impulse, gather(bodies.invInertia, a)), aRxN)));
+		_mm_storeu_pd(out[3], _mm_sub_pd(bx, _mm_mul_pd(bImpulse, nx)));
+		_mm_storeu_pd(out[4], _mm_sub_pd(by, _mm_mul_pd(bImpulse, ny)));
+		_mm_storeu_pd(out[5], _mm_sub_pd(bw, _mm_mul_pd(_mm_mul_pd(impulse, gather(bodies.invInertia, b)), bRxN)));
+		for (int lane = 0; lane < 2; lane++) {
+			bodies.x[a[lane]] = out[0][lane];
+			bodies.y[a[lane]] = out[1][lane];
+			bodies.angle[a[lane]] = out[2][lane];
+			bodies.x[b[lane]] = out[3][lane];
+			bodies.y[b[lane]] = out[4][lane];
+			bodies.angle[b[lane]] = out[5][lane];
+		}
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+static void solveContactRows(const ContactRows<float>& rows, const BodyVelocities<float>& bodies, int first, int last,
+	float restitution)
+{	// Four contacts per step, otherwise the same as the double version
+	const __m128 scale = _mm_set1_ps(-(1 + restitution));
+	const __m128 zero = _mm_setzero_ps();
+	int i = first;
+	for (; i + 4 <= last; i += 4) {
+		const int* a = rows.a + i;
+		const int* b = rows.b + i;
+		auto gather = [&](const float* v, const int* index) {
+			return _mm_set_ps(v[index[3]], v[index[2]], v[index[1]], v[index[0]]);
+		};
+		__m128 nx = _mm_loadu_ps(rows.normalX + i);
+		__m128 ny = _mm_loadu_ps(rows.normalY + i);
+		__m128 aRxN = _mm_loadu_ps(rows.aRxN + i);
+		__m128 bRxN = _mm_loadu_ps(rows.bRxN + i);
+		__m128 ax = gather(bodies.x, a), ay = gather(bodies.y, a), aw = gather(bodies.angle, a);
+		__m128 bx = gather(bodies.x, b), by = gather(bodies.y, b), bw = gather(bodies.angle, b);
+
+		__m128 approach = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(ax, bx), nx), _mm_mul_ps(_mm_sub_ps(ay, by), ny));
+		approach = _mm_sub_ps(_mm_add_ps(approach, _mm_mul_ps(aw, aRxN)), _mm_mul_ps(bw, bRxN));
+		__m128 impulse = _mm_max_ps(zero, _mm_mul_ps(_mm_mul_ps(scale, approach), _mm_loadu_ps(rows.normalMass + i)));
+		__m128 aImpulse = _mm_mul_ps(impulse, gather(bodies.invMass, a));
+		__m128 bImpulse = _mm_mul_ps(impulse, gather(bodies.invMass, b));
+
+		float out[6][4];
+		_mm_storeu_ps(out[0], _mm_add_ps(ax, _mm_mul_ps(aImpulse, nx)));
+		_mm_storeu_ps(out[1], _mm_add_ps(ay, _mm_mul_ps(aImpulse, ny)));
+		_mm_storeu_ps(out[2], _mm_add_ps(aw, _mm_mul_ps(_mm_mul_ps(impulse, gather(bodies.invInertia, a)), aRxN)));
+		_mm_storeu_ps(out[3], _mm_sub_ps(bx, _mm_mul_ps(bImpulse, nx)));
+		_mm_storeu_ps(out[4], _mm_sub_ps(by, _mm_mul_ps(bImpulse, ny)));
+		_mm_storeu_ps(out[5], _mm_sub_ps(bw, _mm_mul_ps(_mm_mul_ps(impulse, gather(bodies.invInertia, b)), bRxN)));
+		for (int lane = 0; lane < 4; lane++) {
+			bodies.x[a[lane]] = out[0][lane];
+			bodies.y[a[lane]] = out[1][lane];
+			bodies.angle[a[lane]] = out[2][lane];
+			bodies.x[b[lane]] = out[3][lane];
+			bodies.y[b[lane]] = out[4][lane];
+			bodies.angle[b[lane]] = out[5][lane];
+		}
+	}
+	Simd::solveContactRowsTail(rows, bodies, i, last, restitution);
+}
+
+void Simd::loadSse2(Kernels<float>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+
+void Simd::loadSse2(Kernels<double>& kernels)
+{
+	kernels.filterBoxes = &filterBoxes;
+	kernels.filterPairs = &filterPairs;
+	kernels.filterWalls = &filterWalls;
+	kernels.transformCorners = &transformCorners;
+	kernels.solveContactRows = &solveContactRows;
+}
+#endif
@@ -0,0 +1,70 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <math.h>
+
+SpatialGrid::SpatialGrid(double width, double height, double cellSize)
+{
+	resize(width, height, cellSize);
+}
+
+double SpatialGrid::cellSize() const
+{
+	return _cellSize;
+}
+
+int SpatialGrid::columns() const
+{
+	return _columns;
+}
+
+int SpatialGrid::rows() const
+{
+	return _rows;
+}
+
+int SpatialGrid::cellOf(double x, double y) const
+{	// Bodies outside the grid are clamped into the border cells
+	int column = std::max(0, std::min(_columns - 1, (int)floor(x / _cellSize)));
+	int row = std::max(0, std::min(_rows - 1, (int)floor(y / _cellSize)));
+	return row * _columns + column;
+}
+
+void SpatialGrid::resize(double width, double height, double cellSize)
+{
+	_cellSize = cellSize;
+	_columns = std::max(1, (int)ceil(width / cellSize));
+	_rows = std::max(1, (int)ceil(height / cellSize));
+	_cellStart.assign(_columns * _rows + 1, 0);
+}
+
+void SpatialGrid::clear()
+{
+	_inserted.clear();
+}
+
+void SpatialGrid::insert(int body, double x, double y)
+{
+	_inserted.push_back({ cellOf(x, y), body });
+}
+
+void SpatialGrid::finalize()
+{	// Counting sort of the inserted bodies by cell
+	std::fill(_cellStart.begin(), _cellStart.end(), 0);
+	for (auto& entry : _inserted)
+		_cellStart[entry.first + 1]++;
+	_occupied.clear();
+	for (int cell = 0; cell + 1 < _cellStart.size(); cell++) {
+		if (_cellStart[cell + 1] > 0)
+			_occupied.push_back(cell);
+		_cellStart[cell + 1] += _cellStart[cell];
+	}
+
+	_bodies.resize(_inserted.size());
+	for (auto& entry : _inserted)
+		_bodies[_cellStart[entry.first]++] = entry.second;
+
+	// Filling shifted every offset one cell forward, shift them back
+	for (int cell = _cellStart.size() - 1; cell > 0; cell--)
+		_cellStart[cell] = _cellStart[cell - 1];
+	_cellStart[0] = 0;
+}
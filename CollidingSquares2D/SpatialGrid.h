@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+class SpatialGrid
+{	// Loose grid, every body is stored once in the cell holding its center
+public:
+	//Constructor
+	SpatialGrid(double width = 1, double height = 1, double cellSize = 1);
+	//Accessors
+	double cellSize() const;
+	int columns() const;
+	int rows() const;
+	int cellOf(double x, double y) const;
+	//Functions
+	void resize(double width, double height, double cellSize);
+	void clear();
+	void insert(int body, double x, double y);
+	void finalize();
+	template<typename Visit> void forEachPair(Visit&& visit) const;
+	template<typename Visit> void forEachNear(double x, double y, Visit&& visit) const;
+private:
+	//Variables
+	double _cellSize;
+	int _columns;
+	int _rows;
+	std::vector<std::pair<int, int>> _inserted;	// (cell, body)
+	std::vector<int> _cellStart;				// Offsets into _bodies, one past the end per cell
+	std::vector<int> _bodies;					// Bodies sorted by cell
+	std::vector<int> _occupied;					// Non-empty cells in ascending order
+};
+
+template<typename Visit>
+void SpatialGrid::forEachPair(Visit&& visit) const
+{	// Each cell against itself and its E, SE, S, SW neighbours visits every pair once
+	static const int forward[4][2] = { { 0, 1 }, { 1, 1 }, { 1, 0 }, { 1, -1 } };
+
+	for (int cell : _occupied) {
+		int row = cell / _columns;
+		int column = cell % _columns;
+		int begin = _cellStart[cell];
+		int end = _cellStart[cell + 1];
+
+		for (int i = begin; i < end; i++)
+			for (int j = i + 1; j < end; j++)
+				visit(_bodies[i], _bodies[j]);
+
+		for (auto& offset : forward) {
+			int otherRow = row + offset[0];
+			int otherColumn = column + offset[1];
+			if (otherRow >= _rows || otherColumn < 0 || otherColumn >= _columns)
+				continue;
+
+			int other = otherRow * _columns + otherColumn;
+			for (int i = begin; i < end; i++)
+				for (int j = _cellStart[other]; j < _cellStart[other + 1]; j++)
+					visit(_bodies[i], _bodies[j]);
+		}
+	}
+}
+
+template<typename Visit>
+void SpatialGrid::forEachNear(double x, double y, Visit&& visit) const
+{	// Bodies in the 3x3 block of cells around (x, y)
+	int cell = cellOf(x, y);
+	int row = cell / _columns;
+	int column = cell % _columns;
+
+	for (int i = std::max(0, row - 1); i <= std::min(_rows - 1, row + 1); i++) {
+		for (int j = std::max(0, column - 1); j <= std::min(_columns - 1, column + 1); j++) {
+			int other = i * _columns + j;
+			for (int k = _cellStart[other]; k < _cellStart[other + 1]; k++)
+				visit(_bodies[k]);
+		}
+	}
+}
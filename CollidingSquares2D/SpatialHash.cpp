@@ -0,0 +1,117 @@
+#include "SpatialHash.h"
+#include <math.h>
+
+SpatialHash::SpatialHash(double cellSize)
+{
+	_cellSize = cellSize;
+	grow(16);
+}
+
+double SpatialHash::cellSize() const
+{
+	return _cellSize;
+}
+
+int SpatialHash::occupiedCells() const
+{
+	return _occupied.size();
+}
+
+void SpatialHash::setCellSize(double cellSize)
+{
+	_cellSize = cellSize;
+}
+
+void SpatialHash::clear()
+{	// Only the slots used last time need resetting
+	for (int slot : _occupied)
+		_table[slot].begin = -1;
+	_occupied.clear();
+	_inserted.clear();
+}
+
+void SpatialHash::insert(int body, double x, double y)
+{
+	// Keep the load factor at or below one half
+	if (2 * (_occupied.size() + 1) > _table.size())
+		grow(2 * _table.size());
+
+	int slot = findOrAdd(cellCoordinate(x), cellCoordinate(y));
+	_table[slot].end++;
+	_inserted.push_back({ slot, body });
+}
+
+void SpatialHash::finalize()
+{	// Counting sort of the inserted bodies by slot, end holds the count until now
+	int offset = 0;
+	for (int slot : _occupied) {
+		auto& cell = _table[slot];
+		cell.begin = offset;
+		offset += cell.end;
+		cell.end = cell.begin;
+	}
+
+	_bodies.resize(_inserted.size());
+	for (auto& entry : _inserted)
+		_bodies[_table[entry.first].end++] = entry.second;
+}
+
+int SpatialHash::cellCoordinate(double v) const
+{
+	return (int)floor(v / _cellSize);
+}
+
+unsigned int SpatialHash::hash(int x, int y) const
+{
+	return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+}
+
+int SpatialHash::find(int x, int y) const
+{
+	unsigned int mask = _table.size() - 1;
+	for (unsigned int slot = hash(x, y) & mask; ; slot = (slot + 1) & mask) {
+		auto& cell = _table[slot];
+		if (cell.begin == -1)
+			return -1;
+		if (cell.x == x && cell.y == y)
+			return slot;
+	}
+}
+
+int SpatialHash::findOrAdd(int x, int y)
+{
+	unsigned int mask = _table.size() - 1;
+	for (unsigned int slot = hash(x, y) & mask; ; slot = (slot + 1) & mask) {
+		auto& cell = _table[slot];
+		if (cell.begin == -1)
+		{
+			cell = { x, y, 0, 0 };
+			_occupied.push_back(slot);
+			return slot;
+		}
+		if (cell.x == x && cell.y == y)
+			return slot;
+	}
+}
+
+void SpatialHash::grow(int minimumCapacity)
+{	// Rehash the occupied slots into a larger table, remapping the slots already handed out
+	int capacity = 16;
+	while (capacity < minimumCapacity)
+		capacity *= 2;
+
+	auto oldTable = std::move(_table);
+	auto oldOccupied = std::move(_occupied);
+	_table.assign(capacity, Slot{ 0, 0, -1, 0 });
+	_occupied.clear();
+
+	std::vector<int> remap(oldTable.size(), -1);
+	for (int slot : oldOccupied) {
+		auto& cell = oldTable[slot];
+		int newSlot = findOrAdd(cell.x, cell.y);
+		_table[newSlot].end = cell.end;
+		remap[slot] = newSlot;
+	}
+	for (auto& entry : _inserted)
+		entry.first = remap[entry.first];
+}
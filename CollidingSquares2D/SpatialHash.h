@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+class SpatialHash
+{	// Unbounded loose grid, cells live in an open addressing table keyed on integer cell coordinates
+public:
+	//Constructor
+	SpatialHash(double cellSize = 1);
+	//Accessors
+	double cellSize() const;
+	int occupiedCells() const;
+	//Functions
+	void setCellSize(double cellSize);
+	void clear();
+	void insert(int body, double x, double y);
+	void finalize();
+	template<typename Visit> void forEachPair(Visit&& visit) const;
+	template<typename Visit> void forEachNear(double x, double y, Visit&& visit) const;
+private:
+	struct Slot {
+		int x;
+		int y;
+		int begin;		// Offsets into _bodies, begin == -1 marks an empty slot
+		int end;
+	};
+
+	//Variables
+	double _cellSize;
+	std::vector<Slot> _table;					// Power of two capacity, linear probing
+	std::vector<int> _occupied;					// Slots in use, in order of first insertion
+	std::vector<std::pair<int, int>> _inserted;	// (slot, body)
+	std::vector<int> _bodies;					// Bodies sorted by slot
+	//Private functions
+	int cellCoordinate(double v) const;
+	unsigned int hash(int x, int y) const;
+	int find(int x, int y) const;
+	int findOrAdd(int x, int y);
+	void grow(int minimumCapacity);
+};
+
+template<typename Visit>
+void SpatialHash::forEachPair(Visit&& visit) const
+{	// Each cell against itself and its E, SE, S, SW neighbours visits every pair once
+	static const int forward[4][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 } };
+
+	for (int slot : _occupied) {
+		auto& cell = _table[slot];
+		for (int i = cell.begin; i < cell.end; i++)
+			for (int j = i + 1; j < cell.end; j++)
+				visit(_bodies[i], _bodies[j]);
+
+		for (auto& offset : forward) {
+			int other = find(cell.x + offset[0], cell.y + offset[1]);
+			if (other < 0)
+				continue;
+
+			auto& neighbour = _table[other];
+			for (int i = cell.begin; i < cell.end; i++)
+				for (int j = neighbour.begin; j < neighbour.end; j++)
+					visit(_bodies[i], _bodies[j]);
+		}
+	}
+}
+
+template<typename Visit>
+void SpatialHash::forEachNear(double x, double y, Visit&& visit) const
+{	// Bodies in the 3x3 block of cells around (x, y)
+	int cx = cellCoordinate(x);
+	int cy = cellCoordinate(y);
+
+	for (int i = cy - 1; i <= cy + 1; i++) {
+		for (int j = cx - 1; j <= cx + 1; j++) {
+			int slot = find(j, i);
+			if (slot < 0)
+				continue;
+
+			for (int k = _table[slot].begin; k < _table[slot].end; k++)
+				visit(_bodies[k]);
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#include "StaticGeometry.h"
+#include <math.h>
+#include <limits>
+using namespace LinearAlgebra;
+using std::min;
+using std::max;
+
+template<typename Real>
+StaticGeometry<Real>::StaticGeometry(double cellSize)
+{
+	_requestedCellSize = cellSize;
+	_shapeStart.push_back(0);
+}
+
+template<typename Real>
+bool StaticGeometry<Real>::empty() const
+{
+	return _shapeLow.empty();
+}
+
+template<typename Real>
+int StaticGeometry<Real>::shapes() const
+{
+	return _shapeLow.size();
+}
+
+template<typename Real>
+int StaticGeometry<Real>::shapeSize(int shape) const
+{
+	return _shapeStart[shape + 1] - _shapeStart[shape];
+}
+
+template<typename Real>
+const Point<Real>* StaticGeometry<Real>::shapeCorners(int shape) const
+{
+	return &_corners[_shapeStart[shape]];
+}
+
+template<typename Real>
+const Point<Real>* StaticGeometry<Real>::shapeNormals(int shape) const
+{
+	return &_normals[_shapeStart[shape]];
+}
+
+template<typename Real>
+void StaticGeometry<Real>::addPolygon(const std::vector<Point<Real>>& corners)
+{	// Normals and box are worked out here once, the grid waits for build
+	Point<double> low = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+	Point<double> high = { std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+	Point<Real> prev = corners.back();
+	for (auto& corner : corners) {
+		_corners.push_back(corner);
+		_normals.push_back(normal(corner, prev));
+		low = { min(low.x, double(corner.x)), min(low.y, double(corner.y)) };
+		high = { max(high.x, double(corner.x)), max(high.y, double(corner.y)) };
+		prev = corner;
+	}
+	_shapeStart.push_back(_corners.size());
+	_shapeLow.push_back(low);
+	_shapeHigh.push_back(high);
+	_columns = 0;
+}
+
+template<typename Real>
+void StaticGeometry<Real>::addSegment(const Point<Real>& from, const Point<Real>& to)
+{	// A two corner polygon, its two edges give the same axis
+	addPolygon({ from, to });
+}
+
+template<typename Real>
+void StaticGeometry<Real>::build()
+{	// Counting sort of the shapes into every cell their boxes cover
+	if (empty())
+		return;
+
+	_low = _shapeLow.front();
+	_high = _shapeHigh.front();
+	double meanExtent = 0;
+	for (int i = 0; i < shapes(); i++) {
+		_low = { min(_low.x, _shapeLow[i].x), min(_low.y, _shapeLow[i].y) };
+		_high = { max(_high.x, _shapeHigh[i].x), max(_high.y, _shapeHigh[i].y) };
+		meanExtent += max(_shapeHigh[i].x - _shapeLow[i].x, _shapeHigh[i].y - _shapeLow[i].y) / shapes();
+	}
+
+	// A few long shapes like floors must not blow up the cell count
+	_cellSize = _requestedCellSize > 0 ? _requestedCellSize : meanExtent;
+	_cellSize = max(_cellSize, max(_high.x - _low.x, _high.y - _low.y) / 1024);
+	_cellSize = max(_cellSize, 1e-9);
+	_columns = max(1, (int)ceil((_high.x - _low.x) / _cellSize));
+	_rows = max(1, (int)ceil((_high.y - _low.y) / _cellSize));
+
+	_shapeCells.resize(shapes());
+	_cellStart.assign(_columns * _rows + 1, 0);
+	for (int i = 0; i < shapes(); i++) {
+		_shapeCells[i] = cellRange(_shapeLow[i], _shapeHigh[i]);
+		auto& cells = _shapeCells[i];
+		for (int row = cells.firstRow; row <= cells.lastRow; row++)
+			for (int column = cells.firstColumn; column <= cells.lastColumn; column++)
+				_cellStart[row * _columns + column + 1]++;
+	}
+	for (int cell = 0; cell + 1 < _cellStart.size(); cell++)
+		_cellStart[cell + 1] += _cellStart[cell];
+
+	_cellShapes.resize(_cellStart.back());
+	auto fill = _cellStart;
+	for (int i = 0; i < shapes(); i++) {
+		auto& cells = _shapeCells[i];
+		for (int row = cells.firstRow; row <= cells.lastRow; row++)
+			for (int column = cells.firstColumn; column <= cells.lastColumn; column++)
+				_cellShapes[fill[row * _columns + column]++] = i;
+	}
+}
+
+template<typename Real>
+typename StaticGeometry<Real>::CellRange StaticGeometry<Real>::cellRange(const Point<double>& low, const Point<double>& high) const
+{
+	return {
+		max(0, min(_columns - 1, (int)floor((low.x - _low.x) / _cellSize))),
+		max(0, min(_columns - 1, (int)floor((high.x - _low.x) / _cellSize))),
+		max(0, min(_rows - 1, (int)floor((low.y - _low.y) / _cellSize))),
+		max(0, min(_rows - 1, (int)floor((high.y - _low.y) / _cellSize))) };
+}
+
+template class StaticGeometry<float>;
+template class StaticGeometry<double>;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "LinearAlgebra.h"
+
+// Obstacles that never move: convex polygons and line segments.
+// Built once into a grid, only dynamic bodies query it and the shapes are never tested against each other.
+template<typename Real>
+class StaticGeometry
+{
+public:
+	//Constructor
+	StaticGeometry(double cellSize = 0);	// 0 picks the cell size from the shapes
+	//Accessors
+	bool empty() const;
+	int shapes() const;
+	int shapeSize(int shape) const;
+	const LinearAlgebra::Point<Real>* shapeCorners(int shape) const;
+	const LinearAlgebra::Point<Real>* shapeNormals(int shape) const;	// One per corner, the edge ending there
+	//Functions
+	void addPolygon(const std::vector<LinearAlgebra::Point<Real>>& corners);	// Convex, either winding
+	void addSegment(const LinearAlgebra::Point<Real>& from, const LinearAlgebra::Point<Real>& to);
+	void build();
+	template<typename Visit> void forEachNear(const LinearAlgebra::Point<double>& low, const LinearAlgebra::Point<double>& high, Visit&& visit) const;
+private:
+	struct CellRange {
+		int firstColumn;
+		int lastColumn;
+		int firstRow;
+		int lastRow;
+	};
+
+	//Variables
+	double _requestedCellSize;
+	double _cellSize = 0;
+	int _columns = 0;
+	int _rows = 0;
+	LinearAlgebra::Point<double> _low;			// Box around all shapes
+	LinearAlgebra::Point<double> _high;
+	std::vector<LinearAlgebra::Point<Real>> _corners;
+	std::vector<LinearAlgebra::Point<Real>> _normals;
+	std::vector<int> _shapeStart;				// Offsets into _corners, one past the end per shape
+	std::vector<LinearAlgebra::Point<double>> _shapeLow;
+	std::vector<LinearAlgebra::Point<double>> _shapeHigh;
+	std::vector<CellRange> _shapeCells;
+	std::vector<int> _cellStart;				// Offsets into _cellShapes, one past the end per cell
+	std::vector<int> _cellShapes;				// Shapes sorted by cell, a shape is in every cell its box covers
+	//Private functions
+	CellRange cellRange(const LinearAlgebra::Point<double>& low, const LinearAlgebra::Point<double>& high) const;
+};
+
+template<typename Real>
+template<typename Visit>
+void StaticGeometry<Real>::forEachNear(const LinearAlgebra::Point<double>& low, const LinearAlgebra::Point<double>& high, Visit&& visit) const
+{	// Shapes whose boxes overlap the given box, each reported by the first cell it shares with the box
+	if (_columns == 0 || high.x < _low.x || high.y < _low.y || _high.x < low.x || _high.y < low.y)
+		return;
+
+	auto range = cellRange(low, high);
+	for (int row = range.firstRow; row <= range.lastRow; row++) {
+		for (int column = range.firstColumn; column <= range.lastColumn; column++) {
+			int cell = row * _columns + column;
+			for (int i = _cellStart[cell]; i < _cellStart[cell + 1]; i++) {
+				int shape = _cellShapes[i];
+				auto& cells = _shapeCells[shape];
+				if (column != std::max(range.firstColumn, cells.firstColumn) || row != std::max(range.firstRow, cells.firstRow))
+					continue;
+				if (high.x < _shapeLow[shape].x || high.y < _shapeLow[shape].y || _shapeHigh[shape].x < low.x || _shapeHigh[shape].y < low.y)
+					continue;
+				visit(shape);
+			}
+		}
+	}
+}
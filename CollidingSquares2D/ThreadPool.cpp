@@ -0,0 +1,78 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+	_nextTask = 0;
+	for (int i = 1; i < threads; i++)
+		_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+int ThreadPool::threads() const
+{
+	return _workers.size() + 1;
+}
+
+void ThreadPool::runTasks(int tasks, const void* work, Invoke invoke)
+{	// A single task, or no workers, runs right here without waking anyone
+	if (tasks <= 0)
+		return;
+	if (tasks == 1 || _workers.empty())
+	{
+		for (int task = 0; task < tasks; task++)
+			invoke(work, task);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_work = work;
+		_invoke = invoke;
+		_tasks = tasks;
+		_nextTask = 0;
+		_busyWorkers = _workers.size();
+		_generation++;
+	}
+	_wake.notify_all();
+	drain();
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_finished.wait(lock, [&] { return _busyWorkers == 0; });
+	_work = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&] { return _stopping || _generation != seen; });
+			if (_stopping)
+				return;
+			seen = _generation;
+		}
+
+		drain();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_busyWorkers == 0)
+			_finished.notify_one();
+	}
+}
+
+void ThreadPool::drain()
+{	// Take tasks until none are left
+	for (int task = _nextTask++; task < _tasks; task = _nextTask++)
+		_invoke(_work, task);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class ThreadPool
+{	// Workers that live as long as the pool, run hands out tasks and returns once all of them are done
+public:
+	//Constructor
+	ThreadPool(int threads = 1);		// Counting the calling thread, which works too
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	//Accessors
+	int threads() const;
+	//Functions
+	template<typename Work> void run(int tasks, const Work& work);	// work(task) for every task
+private:
+	typedef void (*Invoke)(const void* work, int task);
+
+	//Variables
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _finished;
+	const void* _work = nullptr;		// The caller's callable, only valid during run
+	Invoke _invoke = nullptr;
+	int _tasks = 0;
+	std::atomic<int> _nextTask;
+	int _busyWorkers = 0;
+	unsigned int _generation = 0;		// Bumped per run, so workers never pick up a run twice
+	bool _stopping = false;
+	//Private functions
+	void runTasks(int tasks, const void* work, Invoke invoke);
+	void workerLoop();
+	void drain();
+};
+
+template<typename Work>
+void ThreadPool::run(int tasks, const Work& work)
+{	// The callable is passed on by address with a plain function to call it, a std::function holding a capturing
+	// lambda would allocate on every run
+	runTasks(tasks, &work, [](const void* context, int task) { (*static_cast<const Work*>(context))(task); });
+}
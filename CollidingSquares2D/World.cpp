@@ -0,0 +1,153 @@
+#include "World.h"
+#include <algorithm>
+#include <cstddef>
+#include <assert.h>
+#include <stdexcept>
+
+template<typename Real, typename Narrow>
+World<Real, Narrow>::World(int width, int height, int collisionGridColumns, int collisionGridRows)
+	: _collisionManager(width, height, collisionGridColumns, collisionGridRows), _kineticSolver(width, height), _particles(width, height)
+{
+}
+
+template<typename Real, typename Narrow>
+std::vector<Polygon<Real>>& World<Real, Narrow>::bodies()
+{
+	return _bodies;
+}
+
+template<typename Real, typename Narrow>
+const std::vector<Polygon<Real>>& World<Real, Narrow>::bodies() const
+{
+	return _bodies;
+}
+
+template<typename Real, typename Narrow>
+CollisionManager<Real, Narrow>& World<Real, Narrow>::collisionManager()
+{
+	return _collisionManager;
+}
+
+template<typename Real, typename Narrow>
+KineticSolver<Real, Narrow>& World<Real, Narrow>::kineticSolver()
+{
+	return _kineticSolver;
+}
+
+template<typename Real, typename Narrow>
+BarnesHut<Real>& World<Real, Narrow>::longRangeForces()
+{
+	return _longRangeForces;
+}
+
+template<typename Real, typename Narrow>
+ParticleSystem<Real>& World<Real, Narrow>::particles()
+{
+	return _particles;
+}
+
+template<typename Real, typename Narrow>
+const ParticleSystem<Real>& World<Real, Narrow>::particles() const
+{
+	return _particles;
+}
+
+template<typename Real, typename Narrow>
+unsigned long long World<Real, Narrow>::stateHash() const
+{	// FNV-1a over the exact bits in body order, so 1 and N thread runs of a replay can be compared step by step
+	unsigned long long hash = 14695981039346656037ull;
+	auto add = [&](const void* data, std::size_t size) {
+		auto bytes = static_cast<const unsigned char*>(data);
+		for (std::size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	};
+
+	int count = _bodies.size();
+	add(&count, sizeof(count));
+	for (auto& body : _bodies) {
+		Real state[6] = { body.xPos(), body.yPos(), body.angle(), body.xVelocity(), body.yVelocity(), body.angleVelocity() };
+		for (Real value : state)
+			add(&value, sizeof(value));
+	}
+
+	// Particles only when there are any, so hashes of polygon scenes stay as they were
+	int particles = _particles.size();
+	if (particles > 0)
+	{
+		add(&particles, sizeof(particles));
+		for (auto* values : { _particles.xPositions(), _particles.yPositions(), _particles.xVelocities(), _particles.yVelocities() })
+			add(values, particles * sizeof(Real));
+	}
+	return hash;
+}
+
+template<typename Real, typename Narrow>
+void World<Real, Narrow>::addBody(const Polygon<Real>& body)
+{
+	_bodies.push_back(body);
+}
+
+template<typename Real, typename Narrow>
+void World<Real, Narrow>::setSolver(Solver_Method method, int substeps)
+{	// Substeps only matter for Substepped. The event driven solver predicts no pairs across a periodic seam,
+	// so it refuses periodic axes instead of letting bodies pass through each other there.
+	if (method == EventDriven && (_collisionManager.periodicX() || _collisionManager.periodicY()))
+		throw std::invalid_argument("World: the event driven solver does not support periodic axes");
+	_solver = method;
+	_substeps = std::max(1, substeps);
+	_kineticSolver.invalidate();
+	_warmSteps = 0;
+}
+
+template<typename Real, typename Narrow>
+void World<Real, Narrow>::step(Real dt)
+{	// Builds counting heap allocations check in debug that a settled scene steps without touching the heap.
+	// Settled means the same bodies, particles and solver for WarmupSteps steps, so buffers had time to grow.
+#if defined(COUNT_HEAP_ALLOCATIONS) && !defined(NDEBUG)
+	std::size_t sceneSize = _bodies.size() + _particles.size();
+	_warmSteps = sceneSize == _sceneSize ? _warmSteps + 1 : 0;
+	_sceneSize = sceneSize;
+	std::size_t allocations = FrameArena::heapAllocations();
+	int reorders = _collisionManager.reorders();
+	advance(dt);
+	// An opted in body reorder copies shapes, that step is let off
+	assert(_warmSteps < WarmupSteps || _collisionManager.reorders() != reorders || FrameArena::heapAllocations() == allocations);
+#else
+	advance(dt);
+#endif
+}
+
+template<typename Real, typename Narrow>
+void World<Real, Narrow>::advance(Real dt)
+{	// Long range forces kick the velocities and particles collide with the bodies where they start the step,
+	// then body and wall collisions, then static shapes and integration per body.
+	// The event driven solver sees bodies changed by either as changed and predicts everything again.
+	_longRangeForces.applyForces(_bodies, dt, _collisionManager.threadPool());
+	_particles.setPeriodic(_collisionManager.periodicX(), _collisionManager.periodicY());
+	_particles.step(_bodies, _collisionManager.walls(), _collisionManager.threadPool(), dt);
+
+	if (_solver == Substepped)
+	{
+		_collisionManager.resolveSubstepped(_bodies, dt, _substeps);
+		return;
+	}
+	if (_solver == EventDriven)
+	{	// Periodic axes can still be turned on through the collision manager after the solver was picked
+		if (_collisionManager.periodicX() || _collisionManager.periodicY())
+			throw std::logic_error("World: the event driven solver does not support periodic axes");
+		_kineticSolver.step(_bodies, _collisionManager, dt);
+		return;
+	}
+
+	_collisionManager.resolveCollisions(_bodies);
+
+	for (auto& body : _bodies) {
+		_collisionManager.staticCollisionHandling(body);
+		body.updatePosition(dt);
+		_collisionManager.wrapPosition(body);
+	}
+}
+
+template class World<float>;
+template class World<double>;
+template class World<double, float>;
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include "Polygon.h"
+#include "CollisionManager.h"
+#include "KineticSolver.h"
+#include "BarnesHut.h"
+#include "ParticleSystem.h"
+
+enum Solver_Method {
+	ImpulsePerPair,		// One broadphase, one SAT test and one impulse per pair per step
+	Substepped,			// XPBD style, the step split into substeps that share one broadphase
+	EventDriven			// Bodies jump from collision to collision, for sparse walled scenes without static geometry or periodic axes
+};
+
+// Bodies and their collision handling in one scalar type, World<float> and World<double> are both built.
+// World<double, float> keeps the bodies in double and runs the SAT kernels in float, for large worlds.
+template<typename Real, typename Narrow = Real>
+class World
+{
+public:
+	//Constructor
+	World(int width, int height, int collisionGridColumns = 0, int collisionGridRows = 0);
+	//Accessors
+	std::vector<Polygon<Real>>& bodies();
+	const std::vector<Polygon<Real>>& bodies() const;
+	CollisionManager<Real, Narrow>& collisionManager();
+	KineticSolver<Real, Narrow>& kineticSolver();
+	BarnesHut<Real>& longRangeForces();			// Off until given a strength
+	ParticleSystem<Real>& particles();
+	const ParticleSystem<Real>& particles() const;
+	unsigned long long stateHash() const;		// Bits of every body's pose and velocity, equal hashes after a step mean identical runs
+	//Functions
+	void addBody(const Polygon<Real>& body);
+	void setSolver(Solver_Method method, int substeps = 4);
+	void step(Real dt);
+private:
+	static const int WarmupSteps = 120;			// Steps before the debug allocation check starts
+	//Variables
+	std::vector<Polygon<Real>> _bodies;
+	CollisionManager<Real, Narrow> _collisionManager;
+	KineticSolver<Real, Narrow> _kineticSolver;
+	BarnesHut<Real> _longRangeForces;
+	ParticleSystem<Real> _particles;
+	Solver_Method _solver = ImpulsePerPair;
+	int _substeps = 4;
+	std::size_t _sceneSize = 0;					// Bodies plus particles at the last step, for the allocation check
+	int _warmSteps = 0;
+	//Private functions
+	void advance(Real dt);
+};